@@ -28,11 +28,74 @@ struct AABB
 	AEVec2	max;
 };
 
+/**************************************************************************/
+/*!
+	Collision shape of an object type. Two round objects are tested as the
+	circles inscribed in their bounding boxes, every other pair as boxes.
+	*/
+/**************************************************************************/
+enum COLLIDER_SHAPE
+{
+	COLLIDER_RECT = 0,
+	COLLIDER_CIRCLE
+};
+
 bool CollisionIntersection_RectRect(const AABB& aabb1,            //Input
 									const AEVec2& vel1,           //Input 
 									const AABB& aabb2,            //Input 
 									const AEVec2& vel2,           //Input
 									float& firstTimeOfCollision); //Output: the calculated value of tFirst, must be returned here
 
+/**************************************************************************/
+/*!
+	Same test over an explicit time step instead of g_dt, so it can run
+	outside the client frame (e.g. on the server tick). On a hit
+	firstTimeOfCollision is 0 for rectangles that already overlap,
+	otherwise the time of first contact within dt.
+	*/
+/**************************************************************************/
+bool CollisionIntersection_RectRect(const AABB& aabb1,            //Input
+									const AEVec2& vel1,           //Input
+									const AABB& aabb2,            //Input
+									const AEVec2& vel2,           //Input
+									float dt,                     //Input: the time step
+									float& firstTimeOfCollision); //Output: the calculated value of tFirst
+
+/**************************************************************************/
+/*!
+	Tests one rectangle against count candidates over dt. The indices of
+	the candidates it hits are written to hitIndices in ascending order and
+	their first contact times to hitTimes; both need room for count
+	entries. Returns the number of hits. Hits and times are bit identical
+	to calling CollisionIntersection_RectRect on every candidate.
+	*/
+/**************************************************************************/
+unsigned int CollisionIntersection_RectRectBatch(const AABB& aabb1,            //Input
+												 const AEVec2& vel1,           //Input
+												 const AABB* aabb2,            //Input: count candidates
+												 const AEVec2* vel2,           //Input: count candidate velocities
+												 unsigned int count,           //Input
+												 float dt,                     //Input: the time step
+												 unsigned int* hitIndices,     //Output
+												 float* hitTimes);             //Output
+
+
+/**************************************************************************/
+/*!
+	Swept test of two moving circles over dt. Overlapping circles are found
+	with a squared distance test; otherwise circle 1 is swept relative to
+	circle 2 with AEAnimatedCircleToStaticCircle. On a hit
+	firstTimeOfCollision is the time of first contact within dt.
+	*/
+/**************************************************************************/
+bool CollisionIntersection_CircleCircle(const AEVec2& center1,        //Input
+										float radius1,                //Input
+										const AEVec2& vel1,           //Input
+										const AEVec2& center2,        //Input
+										float radius2,                //Input
+										const AEVec2& vel2,           //Input
+										float dt,                     //Input: the time step
+										float& firstTimeOfCollision); //Output
+
 
 #endif // CSD1130_COLLISION_H_
\ No newline at end of file
@@ -0,0 +1,117 @@
+// EntityStore.h
+#ifndef ENTITY_STORE_H
+#define ENTITY_STORE_H
+
+#include "Collision.h"
+#include "NetworkProtocol.h"
+#include "SimScalar.h"
+#include <cstdint>
+#include <vector>
+
+// Handle of an entity: slot in the low 16 bits, generation of the slot in the high 16 bits.
+// A handle goes stale when its entity is destroyed, even after the slot is reused.
+typedef uint32_t EntityID;
+const EntityID INVALID_ENTITY = 0;
+
+// Fields no per tick pass reads, kept out of the hot arrays
+struct EntityCold {
+    AEMtx33 transform;      // filled by BuildTransform, the server has nothing to draw
+    ClientID owner;         // player that owns a ship or fired a bullet
+};
+
+// Structure of arrays storage for the server simulation.
+// Every field has its own array, indexed by a dense index 0..Count()-1, so a pass only
+// streams the fields it uses. Handles map to dense indices through a sparse slot table.
+//
+// Destroy only marks an entity; it keeps its dense index until FlushDestroyed, which
+// moves the last entity into each hole. Dense indices are therefore valid for a whole
+// tick, a flush costs the number of entities destroyed rather than the number alive, and
+// the dense order is not creation order.
+class EntityStore {
+public:
+    explicit EntityStore(uint32_t capacity);
+
+    // Remove every entity and invalidate all handles
+    void Clear();
+
+    // Returns INVALID_ENTITY when the store is full
+    EntityID Create(uint8_t type, const AEVec2& scale, const SimVec2& pos, const SimVec2& vel, SimScalar dir);
+    void Destroy(EntityID id);
+
+    // Alive and not destroyed this tick
+    bool IsAlive(EntityID id) const;
+
+    // Dense index of a live handle, valid until the next FlushDestroyed
+    uint32_t IndexOf(EntityID id) const { return sparse[id & SLOT_MASK]; }
+    EntityID IdAt(uint32_t index) const { return ids[index]; }
+
+    // Slot of a handle, unique among the live entities
+    static uint16_t SlotOf(EntityID id) { return static_cast<uint16_t>(id & SLOT_MASK); }
+
+    // Fill the holes of the entities destroyed since the last flush, once per tick
+    void FlushDestroyed();
+
+    // Entries in the dense arrays, including the ones destroyed this tick
+    uint32_t Count() const { return static_cast<uint32_t>(ids.size()); }
+    uint32_t GetCapacity() const { return capacity; }
+
+    // Bounding box from the current position and scale
+    void UpdateBounds(uint32_t index);
+
+    // Advance every entity by dt in one pass: save the previous position, integrate the
+    // velocity, wrap the types in wrapTypes (bit 1 << type, types below 32) around the
+    // world like AEWrap, and rebuild the bounding boxes. Uses SSE2 where available; the
+    // scalar path gives bit identical results. Fixed point builds take the scalar path.
+    void Integrate(float dt, const AABB& world, uint32_t wrapTypes);
+
+    // Object to world matrix, computed on request into the cold table
+    const AEMtx33& BuildTransform(uint32_t index);
+
+    // Hot arrays, all Count() long and indexed by dense index. The motion state is in
+    // simulation numbers (SimScalar.h); scale and bounding boxes stay float.
+    std::vector<uint8_t> type;
+    std::vector<uint8_t> active;            // 0 once destroyed, until the flush removes it
+    std::vector<SimVec2> posCurr;
+    std::vector<SimVec2> posPrev;
+    std::vector<SimVec2> velCurr;
+    std::vector<AEVec2> scale;
+    std::vector<SimScalar> dirCurr;
+    std::vector<AABB> boundingBox;
+
+    // Cold table, same indexing
+    std::vector<EntityCold> cold;
+
+private:
+    static constexpr uint32_t SLOT_BITS = 16;
+    static constexpr uint32_t SLOT_MASK = (1u << SLOT_BITS) - 1;
+
+    void IntegrateScalar(uint32_t begin, uint32_t end, float dt, const AABB& world, uint32_t wrapTypes);
+
+    // Copy entity from into dense index to, slot table included
+    void MoveEntity(uint32_t from, uint32_t to);
+    void PopBack();
+
+    // Generation 0 is skipped so no handle equals INVALID_ENTITY
+    static uint16_t NextGeneration(uint16_t value) { return static_cast<uint16_t>(value == UINT16_MAX ? 1 : value + 1); }
+
+    uint32_t capacity;
+    std::vector<EntityID> ids;              // dense index -> handle
+    std::vector<uint32_t> sparse;           // slot -> dense index, kept up to date by every move
+    std::vector<uint16_t> generation;       // slot -> generation of its current handle
+    std::vector<uint32_t> freeSlots;        // unused slots, the next one to use on top
+    std::vector<uint32_t> destroyedIndices; // dense indices with active == 0, in the order destroyed
+};
+
+inline void EntityStore::UpdateBounds(uint32_t index) {
+    // Unit square scaled by the entity
+    float halfX = scale[index].x * 0.5f;
+    float halfY = scale[index].y * 0.5f;
+    float posX = SimToFloat(posCurr[index].x);
+    float posY = SimToFloat(posCurr[index].y);
+    boundingBox[index].min.x = posX - halfX;
+    boundingBox[index].min.y = posY - halfY;
+    boundingBox[index].max.x = posX + halfX;
+    boundingBox[index].max.y = posY + halfY;
+}
+
+#endif // ENTITY_STORE_H
@@ -0,0 +1,101 @@
+// FixedPoint.h
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <cstdint>
+
+// Signed 16.16 fixed point number for the lockstep simulation.
+// Every operation is integer arithmetic, so a result is the same bits with any compiler,
+// optimizer setting or CPU, unlike float math whose rounding depends on contraction,
+// x87 precision and the C library. Range is about +-32767 with a step of 1/65536: fine
+// for positions and velocities, products of two large values (squared distances) must
+// go through the wide helpers below instead.
+// Right shifts of negative values are arithmetic on every compiler the project builds with.
+class Fixed {
+public:
+    static constexpr int FRACTION_BITS = 16;
+    static constexpr int32_t ONE = 1 << FRACTION_BITS;
+
+    constexpr Fixed() : raw(0) {}
+
+    // Rounded to the nearest step. Scaling by a power of two is exact in float, so the
+    // conversion only depends on the float it is given.
+    explicit constexpr Fixed(float value)
+        : raw(static_cast<int32_t>(value * static_cast<float>(ONE) + (value < 0.0f ? -0.5f : 0.5f))) {
+    }
+
+    static constexpr Fixed FromRaw(int32_t value) {
+        Fixed result;
+        result.raw = value;
+        return result;
+    }
+
+    constexpr int32_t Raw() const { return raw; }
+
+    // Exact for values below 256, 24 bits of mantissa hold the whole fixed number
+    float ToFloat() const { return static_cast<float>(raw) * (1.0f / ONE); }
+
+    constexpr Fixed operator-() const { return FromRaw(-raw); }
+    constexpr Fixed operator+(Fixed other) const { return FromRaw(raw + other.raw); }
+    constexpr Fixed operator-(Fixed other) const { return FromRaw(raw - other.raw); }
+
+    // Truncated toward minus infinity, like the shift
+    constexpr Fixed operator*(Fixed other) const {
+        return FromRaw(static_cast<int32_t>((static_cast<int64_t>(raw) * other.raw) >> FRACTION_BITS));
+    }
+
+    // Truncated toward zero, like integer division; other must not be 0
+    constexpr Fixed operator/(Fixed other) const {
+        return FromRaw(static_cast<int32_t>((static_cast<int64_t>(raw) * ONE) / other.raw));
+    }
+
+    Fixed& operator+=(Fixed other) { raw += other.raw; return *this; }
+    Fixed& operator-=(Fixed other) { raw -= other.raw; return *this; }
+    Fixed& operator*=(Fixed other) { return *this = *this * other; }
+    Fixed& operator/=(Fixed other) { return *this = *this / other; }
+
+    constexpr bool operator==(Fixed other) const { return raw == other.raw; }
+    constexpr bool operator!=(Fixed other) const { return raw != other.raw; }
+    constexpr bool operator<(Fixed other) const { return raw < other.raw; }
+    constexpr bool operator>(Fixed other) const { return raw > other.raw; }
+    constexpr bool operator<=(Fixed other) const { return raw <= other.raw; }
+    constexpr bool operator>=(Fixed other) const { return raw >= other.raw; }
+
+private:
+    int32_t raw;
+};
+
+// Same layout as AEVec2: two 32-bit members
+struct FixedVec2 {
+    Fixed x;
+    Fixed y;
+};
+
+constexpr Fixed FIXED_PI = Fixed::FromRaw(205887);          // pi * 65536, rounded
+constexpr Fixed FIXED_HALF_PI = Fixed::FromRaw(102944);
+constexpr Fixed FIXED_TWO_PI = Fixed::FromRaw(411775);
+
+// Sine and cosine of an angle in radians, any range. Polynomial evaluated in 2.30 fixed
+// point, the error is below one 16.16 step.
+Fixed FixedSin(Fixed angle);
+Fixed FixedCos(Fixed angle);
+
+// Square root of a non-negative value, rounded down
+Fixed FixedSqrt(Fixed value);
+
+// Length of (x, y) without forming the squares in 16.16, which overflow past 181
+Fixed FixedLength(Fixed x, Fixed y);
+
+// Wrap x around [low, high] like AEWrap: one range is added below low or removed above high
+Fixed FixedWrap(Fixed x, Fixed low, Fixed high);
+
+// Swept tests of the server narrowphase, with the semantics of the float versions in
+// Collision.h: time is 0 for shapes that already overlap, otherwise the time of first
+// contact within dt.
+bool FixedCollision_RectRect(const FixedVec2& min1, const FixedVec2& max1, const FixedVec2& vel1,
+    const FixedVec2& min2, const FixedVec2& max2, const FixedVec2& vel2, Fixed dt, Fixed& time);
+
+bool FixedCollision_CircleCircle(const FixedVec2& center1, Fixed radius1, const FixedVec2& vel1,
+    const FixedVec2& center2, Fixed radius2, const FixedVec2& vel2, Fixed dt, Fixed& time);
+
+#endif // FIXED_POINT_H
@@ -0,0 +1,64 @@
+// FlatMap.h
+#ifndef FLAT_MAP_H
+#define FLAT_MAP_H
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+// Sorted vector with the part of the std::map interface the server uses.
+// All entries are in one block, so copying the map is a single copy of the block (no
+// allocations when the destination has the capacity) and iterating it walks memory in
+// order. Meant for a few entries: insert and erase move the entries after the key.
+// Inserting or erasing invalidates iterators and references, like std::vector.
+template <typename Key, typename Value>
+class FlatMap {
+public:
+    typedef std::pair<Key, Value> value_type;
+    typedef typename std::vector<value_type>::iterator iterator;
+    typedef typename std::vector<value_type>::const_iterator const_iterator;
+
+    void reserve(size_t count) { entries.reserve(count); }
+
+    iterator begin() { return entries.begin(); }
+    iterator end() { return entries.end(); }
+    const_iterator begin() const { return entries.begin(); }
+    const_iterator end() const { return entries.end(); }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    void clear() { entries.clear(); }
+
+    iterator find(const Key& key) {
+        iterator it = LowerBound(key);
+        return (it != entries.end() && it->first == key) ? it : entries.end();
+    }
+
+    // Inserts a default constructed value when the key is missing
+    Value& operator[](const Key& key) {
+        iterator it = LowerBound(key);
+        if (it == entries.end() || it->first != key) {
+            it = entries.insert(it, value_type(key, Value()));
+        }
+        return it->second;
+    }
+
+    size_t erase(const Key& key) {
+        iterator it = find(key);
+        if (it == entries.end()) {
+            return 0;
+        }
+        entries.erase(it);
+        return 1;
+    }
+
+private:
+    iterator LowerBound(const Key& key) {
+        return std::lower_bound(entries.begin(), entries.end(), key,
+            [](const value_type& entry, const Key& k) { return entry.first < k; });
+    }
+
+    std::vector<value_type> entries;
+};
+
+#endif // FLAT_MAP_H
@@ -3,13 +3,68 @@
 #define GAME_SERVER_H
 
 #include "UDPNetwork.h"
+#include "SpatialHash.h"
+#include "EntityStore.h"
+#include "MatchRandom.h"
+#include "MatchLog.h"
+#include "WorldHash.h"
+#include "FlatMap.h"
+#include "RingBuffer.h"
 #include "main.h"
+#include <atomic>
 #include <vector>
-#include <map>
 #include <mutex>
 
-// Forward declarations
-struct GameObjInst;
+// Results of replaying a packet capture through the server
+struct CaptureReplayStats {
+    uint64_t inboundPackets;    // datagrams fed back through the receive path
+    uint64_t inboundBytes;
+    uint64_t capturedOutbound;  // datagrams the live server sent (for comparison)
+    uint64_t rateLimitedPackets; // inbound datagrams dropped by the rate limiter
+    uint64_t ticks;             // GameServer::Update calls replayed
+    double totalTickUs;         // CPU time spent in Update
+    double p50TickUs;
+    double p99TickUs;
+    double maxTickUs;
+
+    CaptureReplayStats() : inboundPackets(0), inboundBytes(0), capturedOutbound(0), rateLimitedPackets(0), ticks(0),
+        totalTickUs(0.0), p50TickUs(0.0), p99TickUs(0.0), maxTickUs(0.0) {
+    }
+};
+
+// Results of replaying a match log through the simulation
+struct MatchReplayStats {
+    uint64_t ticks;             // ticks re-simulated
+    uint64_t events;            // joins, leaves and input changes applied
+    uint64_t hashChecks;        // ticks whose world hash was compared
+    bool diverged;              // a world hash differed from the recorded one
+    uint32_t divergedTick;      // first tick that differed
+    double totalTickUs;         // CPU time spent in the ticks
+    double p50TickUs;
+    double p99TickUs;
+    double maxTickUs;
+
+    MatchReplayStats() : ticks(0), events(0), hashChecks(0), diverged(false), divergedTick(0), totalTickUs(0.0),
+        p50TickUs(0.0), p99TickUs(0.0), maxTickUs(0.0) {
+    }
+};
+
+// Counters of the rollback mode
+struct RollbackStats {
+    uint64_t stampedInputs;     // inputs received with the tick they are for
+    uint64_t lateInputs;        // arrived after their tick was simulated
+    uint64_t mispredictions;    // late inputs that differ from what the server predicted
+    uint64_t tooLateInputs;     // older than the window or than a join or leave, applied from the next tick
+    uint64_t rollbacks;         // rewinds; mispredictions between two ticks share one
+    uint64_t resimulatedTicks;
+    uint32_t maxRollbackTicks;
+    double totalRollbackUs;     // CPU time spent restoring and re-simulating
+    double maxRollbackUs;
+
+    RollbackStats() : stampedInputs(0), lateInputs(0), mispredictions(0), tooLateInputs(0), rollbacks(0),
+        resimulatedTicks(0), maxRollbackTicks(0), totalRollbackUs(0.0), maxRollbackUs(0.0) {
+    }
+};
 
 // Game server class
 class GameServer {
@@ -17,22 +72,88 @@ public:
     GameServer();
     ~GameServer();
 
-    // Initialize the server
-    bool Initialize(uint16_t port);
+    // Initialize the server (maxPlayers above 4 is meant for load testing)
+    bool Initialize(uint16_t port, size_t maxPlayers = 4);
 
     // Shutdown the server
     void Shutdown();
 
-    // Run one frame of the game server
+    // Advance the server by the frame time; the simulation runs in fixed TICK_DT steps
     void Update(float dt);
 
+    // Number of the next simulation tick
+    uint32_t GetCurrentTick() const { return currentTick; }
+
+    // Ticks dropped because Update fell more than MAX_TICKS_PER_UPDATE behind
+    uint64_t GetSkippedTickCount() const { return skippedTicks; }
+
     // Get current player count
     size_t GetPlayerCount() const { return server.GetClientCount(); }
 
     // Get if the server is running
     bool IsRunning() const { return isRunning; }
 
+    // Record all server traffic and ticks to a capture file
+    bool StartCapture(const std::string& path) { return server.StartCapture(path); }
+    void StopCapture() { server.StopCapture(); }
+
+    // Inbound rate limits of the client connections
+    void SetRateLimit(const RateLimitConfig& config) { server.SetRateLimit(config); }
+    RateLimitStats GetRateLimitStats() const { return server.GetRateLimitStats(); }
+
+    // Replay a capture headless and as fast as possible, measuring CPU per tick
+    bool RunCaptureReplay(const std::string& path, CaptureReplayStats& stats);
+
+    // Deterministic mode: match n draws all its random numbers from a stream derived from
+    // seed and n, so the same seed and the same inputs give a bit identical world.
+    // Without it the seed comes from std::random_device; the log prints it per match.
+    void SetRandomSeed(uint64_t seed);
+    uint64_t GetRandomSeed() const { return randomSeed; }
+
+    // Record the seed, joins, leaves and input changes of every tick to a match log.
+    // Must start before the first player joins, the replay starts from an empty server.
+    // withHashes adds the world hash after every tick so the replay can check it.
+    bool StartMatchLog(const std::string& path, bool withHashes);
+    void StopMatchLog();
+
+    // Re-simulate a match log headless and as fast as possible, measuring CPU per tick
+    // and comparing the recorded world hashes
+    bool RunMatchLogReplay(const std::string& path, MatchReplayStats& stats);
+
+    // Hash of the simulated world: entities, players and the random stream
+    uint64_t ComputeStateHash();
+
+    // Put a WorldHash in every snapshot and check the hashes clients send back with their
+    // input; mismatches are logged with the tick
+    void SetWorldHashes(bool enable);
+    uint64_t GetWorldHashMismatchCount() const { return worldHashMismatches; }
+
+    // Event replication: asteroids and bullets go out once, as OBJECT_EVENTS when they
+    // appear or go, and clients move them in between. Snapshots carry them only every
+    // OBJECT_CORRECTION_INTERVAL ticks and right after a join, to correct the clients'
+    // copies; the other snapshots carry the ships only.
+    void SetEventReplication(bool enable);
+
+    // Keep the world state at the start of each of the last `ticks` ticks, for rollback and
+    // speculative simulation; 0 turns the history off
+    void SetSavedStateCount(unsigned int ticks);
+
+    // Put the world back to the start of a saved tick; the next tick simulated is that tick
+    bool RestoreWorldState(uint32_t tick);
+
+    // Rollback mode for small rooms. Clients stamp their input with the tick it is for; a
+    // tick with no input from a player repeats that player's last one. An input arriving up
+    // to window ticks late that differs from the prediction rewinds the world to its tick
+    // and simulates forward again. Inputs are relayed every tick as INPUT_FRAME messages and
+    // full snapshots drop to one per ROLLBACK_SNAPSHOT_INTERVAL. 0 turns the mode off.
+    // Not available while a match log is recording, the log holds inputs as they arrive.
+    bool SetRollbackWindow(unsigned int window);
+    RollbackStats GetRollbackStats();
+
 private:
+    // The headless checks set up worlds and step the tick directly
+    friend class ServerTools;
+
     // Network event handlers
     void OnClientConnect(ClientID clientID);
     void OnClientDisconnect(ClientID clientID);
@@ -41,52 +162,207 @@ private:
     // Process player input
     void ProcessPlayerInput(ClientID clientID, const PlayerInputMessage* inputMsg);
 
+    // One fixed simulation step, after a rollback if one is pending
+    void Tick();
+    void SimulateTick();
+
+    // Rollback mode
+    void StampInput(ClientID clientID, uint32_t tick, uint8_t buttons);
+    void ApplyTickInputs();             // lastInput of every player for currentTick
+    void Rollback();
+    void SendInputFrame();
+
     // Game state management
     void UpdateGameState(float dt);
     void CheckForCollisions();
+
+    // Narrowphase of one entity (dense index) against the asteroids near its swept box.
+    // Returns the number of hits, listed in candidateHits with their times of impact.
+    unsigned int CollideWithAsteroids(uint32_t index);
     void CheckGameEndConditions();
+    void SendGameEnd();
     void SendGameState();
+    void SendObjectEvents();            // event replication: changes since the last call
+    void CorrectObjectsAfterRollback(); // event replication: what the re-simulation changed
     void ResetGame();
 
+    // Asteroids and bullets come and go through these, event replication lists them
+    void LogObjectSpawn(EntityID id);
+    void DestroyObject(EntityID id);
+
     // Player management
     void CreatePlayerShip(ClientID clientID);
     void RemovePlayerShip(ClientID clientID);
+    void RemovePlayerBullets(ClientID clientID);
 
     // Asteroid management
     void CreateInitialAsteroids();
-    void CreateAsteroid(float x, float y, float velX, float velY, float scale);
-    void SplitAsteroid(GameObjInst* asteroid);
+    void CreateAsteroid(const SimVec2& pos, const SimVec2& vel, float scale);
+    void SplitAsteroid(uint32_t index);    // dense index in entities
 
     UDPServer server;
+    MessageDispatcher<ClientID> messageHandlers;  // game messages forwarded by the UDP server
     bool isRunning;
     bool gameInProgress;
-    float gameStateTimer;        // Time since last game state broadcast
+    float tickAccumulator;       // Frame time not yet simulated
+    uint32_t currentTick;        // Number of the next simulation tick
+    uint64_t skippedTicks;       // Ticks dropped by the catch-up limit
     float gameEndTimer;          // Timer for game end state
+    uint16_t snapshotSequence;   // Sequence number of the next game state broadcast
+    uint64_t randomSeed;         // Seed of the match random streams
+    uint32_t matchCount;         // Matches started since the seed was set
+    MatchRandom random;          // Random stream of the current match
+    MatchLogWriter matchLog;     // Written under playersMutex
+    bool matchLogHashes;         // Tick records carry the world hash
+
+    // World hashes of the recent snapshots, by snapshot number, to check client acks against
+    struct SentWorldHash {
+        uint32_t tick;
+        uint32_t hash;
+    };
+    static constexpr unsigned int WORLD_HASH_HISTORY = 64;                 // a bit over 3 seconds of snapshots
+    bool worldHashes;
+    SentWorldHash sentWorldHashes[WORLD_HASH_HISTORY];
+    std::atomic<uint64_t> worldHashMismatches;
+
+    // A bullet in its owner's ring. Every bullet lives the same number of ticks, so a
+    // player's bullets expire in the order they were fired.
+    struct PlayerBullet {
+        EntityID id;
+        uint32_t expireTick;            // first tick it is gone in, removed before the collisions
+    };
+
+    // Bullets a player can have in flight. With a full ring fire does nothing until a bullet
+    // expires or hits something; 4 players use 64 of the entity slots at most
+    static constexpr unsigned int PLAYER_BULLET_CAPACITY = 16;
 
     // Player data
     struct PlayerData {
-        GameObjInst* ship;
+        EntityID ship;
         bool isAlive;
         uint32_t score;
         uint8_t lives;
+        bool fireHeld;                  // fire was down last tick, a shot needs a new press
         PlayerInputMessage lastInput;
+        RingBuffer<PlayerBullet, PLAYER_BULLET_CAPACITY> bullets;   // oldest at the front
     };
 
-    std::map<ClientID, PlayerData> players;
-    std::mutex playersMutex;
+    FlatMap<ClientID, PlayerData> players;      // sorted by ClientID like the std::map it replaces
+    std::recursive_mutex playersMutex;
+
+    // Game objects. The asteroid list holds handles into entities in no particular order,
+    // removal swaps the last handle into the hole; bullets are in their owner's ring.
+    EntityStore entities;
+    std::vector<EntityID> asteroids;
+    std::recursive_mutex gameObjectsMutex;
+
+    // Everything the simulation reads, as saved at the start of a tick. Each part is one
+    // contiguous block allocated up front, so saving or restoring a state is a few block
+    // copies and never allocates.
+    struct SavedWorldState {
+        uint32_t tick;                          // tick simulated next from this state
+        bool valid;
+        bool gameInProgress;
+        float gameEndTimer;
+        uint32_t matchCount;
+        MatchRandom random;
+        FlatMap<ClientID, PlayerData> players;
+        EntityStore entities;
+        std::vector<EntityID> asteroids;
+
+        explicit SavedWorldState(uint32_t capacity);
+    };
+
+    // Called at the start of every tick while the history is on
+    void SaveWorldState();
+
+    std::vector<SavedWorldState> savedStates;   // ring, tick % size
+
+    // Input of one player for one tick in rollback mode
+    struct TickInput {
+        uint32_t tick;
+        uint8_t buttons;                // received for the tick
+        uint8_t usedButtons;            // what the tick was simulated with
+        bool confirmed;                 // buttons were received
+        bool used;                      // the tick was simulated
+    };
+
+    static constexpr uint32_t NO_ROLLBACK = UINT32_MAX;
+
+    unsigned int rollbackWindow;
+    std::vector<TickInput> tickInputs;          // per ClientID a ring of 2 * window ticks, past and future
+    std::vector<InputFrameEntry> relayedInputs; // received since the last input frame
+    uint32_t rollbackTick;                      // earliest tick to simulate again, NO_ROLLBACK if none
+    uint32_t rollbackFloor;                     // joins and leaves are not rewound past
+    bool resimulating;                          // no output while ticks are simulated again
+    uint32_t announcedEndMatch;                 // matchCount of the last match whose end was sent
+    unsigned int sentGameEnds;                  // GAME_END messages queued, for the checks
+    RollbackStats rollbackStats;
+
+    // Event replication
+    bool eventReplication;
+    bool objectSnapshotPending;                 // a client joined, the next snapshot carries the objects
+    uint16_t objectEventSequence;
+    std::vector<EntityID> replicatedObjects;    // entity slot -> handle the clients were told about
+    std::vector<EntityID> spawnedObjects;       // asteroids and bullets created since the last events
+    std::vector<EntityID> destroyedObjects;     // and destroyed
+    std::vector<char> objectEvents;             // message being filled
+
+    // An object as the clients extrapolate it, kept across a rollback to find what changed
+    struct ObjectState {
+        EntityID id;
+        SimVec2 pos;
+        SimVec2 vel;
+    };
+    std::vector<ObjectState> objectsBeforeRollback;
+
+    // A bullet or ship touching an asteroid during the tick, at time of impact time
+    struct CollisionEvent {
+        float time;             // seconds into the tick
+        uint8_t kind;           // COLLISION_BULLET or COLLISION_SHIP
+        uint32_t other;         // bullet: player position * PLAYER_BULLET_CAPACITY + ring position;
+                                // ship: its ClientID
+        uint32_t asteroid;      // position in asteroids
+
+        bool operator<(const CollisionEvent& rhs) const {
+            if (time != rhs.time) return time < rhs.time;
+            if (kind != rhs.kind) return kind < rhs.kind;
+            if (other != rhs.other) return other < rhs.other;
+            return asteroid < rhs.asteroid;
+        }
+    };
+    enum : uint8_t { COLLISION_BULLET = 0, COLLISION_SHIP = 1 };
+
+    // Collision broadphase over the asteroids, the tick's contacts and per tick hit flags,
+    // reused between ticks
+    SpatialHash asteroidGrid;
+    std::vector<CollisionEvent> collisionEvents;
+    std::vector<uint8_t> asteroidHit;
+    std::vector<uint8_t> bulletHit;
+
+    // Narrowphase batch of one query: candidates from the grid and the ones hit
+    std::vector<uint32_t> candidateAsteroids;       // positions in asteroids
+    std::vector<AABB> candidateBoxes;               // moved next to the query by the wrap offset
+    std::vector<AEVec2> candidateVelocities;
+    std::vector<AEVec2> candidateOffsets;           // SIM_FIXED_POINT: wrap offsets, instead of the two above
+    std::vector<unsigned int> candidateHits;        // positions in the candidate arrays
+    std::vector<float> candidateHitTimes;
 
-    // Game objects
-    std::vector<GameObjInst*> asteroids;
-    std::vector<GameObjInst*> bullets;
-    std::mutex gameObjectsMutex;
+    // Simulation clock
+    static constexpr unsigned int TICK_RATE = SIMULATION_TICK_RATE;    // simulation ticks per second
+    static constexpr float TICK_DT = 1.0f / TICK_RATE;
+    static constexpr unsigned int SNAPSHOT_TICK_INTERVAL = 3;          // snapshot every 3rd tick, 20 per second
+    static constexpr unsigned int MAX_TICKS_PER_UPDATE = 5;            // catch-up limit after a stall
+    static constexpr unsigned int ROLLBACK_SNAPSHOT_INTERVAL = 60;     // resync snapshot once a second
+    static constexpr unsigned int OBJECT_CORRECTION_INTERVAL = 60;     // event replication: objects once a second
 
     // Game settings
-    static constexpr float GAME_STATE_UPDATE_INTERVAL = 1.0f / 20.0f;  // 20 updates per second
     static constexpr float GAME_END_DURATION = 5.0f;                   // 5 seconds for end game screen
     static constexpr unsigned int INITIAL_ASTEROID_COUNT = 4;
     static constexpr unsigned int MAX_ASTEROID_COUNT = 20;
     static constexpr unsigned int INITIAL_LIVES = 3;
     static constexpr float BULLET_LIFETIME = 2.0f;                     // Bullets live for 2 seconds
+    static constexpr unsigned int BULLET_LIFETIME_TICKS = static_cast<unsigned int>(BULLET_LIFETIME * TICK_RATE);
 };
 
 #endif // GAME_SERVER_H
\ No newline at end of file
@@ -24,6 +24,9 @@ void GameStateAsteroidsDraw(void);
 void GameStateAsteroidsFree(void);
 void GameStateAsteroidsUnload(void);
 
+// developer tool, times the collision phase of a frame (see Main.cpp)
+void GameStateAsteroidsCollisionBenchmark(void);
+
 // ---------------------------------------------------------------------------
 
 #endif // CSD1130_GAME_STATE_PLAY_H_
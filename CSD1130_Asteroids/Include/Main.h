@@ -21,6 +21,8 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 
 extern float	g_dt;
 extern double	g_appTime;
+extern unsigned long long	g_randomSeed;		// seed given with "-seed <n>"
+extern bool					g_randomSeedFixed;	// true if "-seed" was given
 
 // ---------------------------------------------------------------------------
 // includes
@@ -0,0 +1,105 @@
+// MatchLog.h
+#ifndef MATCH_LOG_H
+#define MATCH_LOG_H
+
+#include "NetworkProtocol.h"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Match log file layout:
+//   MatchLogFileHeader
+//   repeated { MatchLogRecord kind (1 byte), payload }
+// Payload per kind:
+//   JOIN, LEAVE     client ID (1 byte)
+//   INPUT           client ID (1 byte), InputButtons bits (1 byte)
+//   TICK            nothing
+//   TICK_HASH       world hash after the tick (8 bytes)
+// Events apply in file order; a tick record means one GameServer tick ran after the
+// events before it. All fields are little-endian, exactly as the x86/x64 server writes them.
+//
+// Unlike a packet capture the log holds only what changes the simulation: one byte per
+// tick (nine with hashes) plus three per input change, and it replays without the network.
+
+constexpr uint32_t MATCH_LOG_MAGIC = 0x474C4D41; // "AMLG"
+constexpr uint16_t MATCH_LOG_VERSION = 4;    // 2: pressing fire spawns bullets, 3: capped bullets in flight,
+                                             // 4: hits free their ring slot
+
+enum class MatchLogRecord : uint8_t {
+    JOIN = 0,
+    LEAVE = 1,
+    INPUT = 2,          // only written when a player's buttons change
+    TICK = 3,
+    TICK_HASH = 4
+};
+
+#pragma pack(push, 1)
+struct MatchLogFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint64_t randomSeed;    // GameServer random seed when the log started
+    uint32_t matchCount;    // matches already started with that seed
+
+    MatchLogFileHeader() : magic(MATCH_LOG_MAGIC), version(MATCH_LOG_VERSION), reserved(0), randomSeed(0),
+        matchCount(0) {
+    }
+};
+#pragma pack(pop)
+
+// Append-only match log writer.
+// Not locked: GameServer writes every record while holding its players mutex, which
+// also orders the records exactly as the events were applied.
+class MatchLogWriter {
+public:
+    MatchLogWriter();
+    ~MatchLogWriter();
+
+    bool Open(const std::string& path, const MatchLogFileHeader& header);
+    void Close();
+
+    bool IsOpen() const { return file != nullptr; }
+
+    void WriteEvent(MatchLogRecord kind, uint8_t clientID);
+    void WriteInput(uint8_t clientID, uint8_t buttons);
+    void WriteTick();
+    void WriteTick(uint64_t hash);
+
+private:
+    void Append(const void* data, size_t size);
+
+    static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    FILE* file;
+    std::vector<char> buffer;
+};
+
+// One record of a match log, as read back
+struct MatchLogEntry {
+    MatchLogRecord kind;
+    uint8_t clientID;       // JOIN, LEAVE and INPUT
+    uint8_t buttons;        // INPUT
+    uint64_t hash;          // TICK_HASH
+};
+
+// Sequential match log reader used by the replay tool
+class MatchLogReader {
+public:
+    MatchLogReader();
+    ~MatchLogReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const MatchLogFileHeader& GetHeader() const { return header; }
+
+    // Read the next record; returns false at end of file or on a truncated or unknown record
+    bool Next(MatchLogEntry& entry);
+
+private:
+    FILE* file;
+    MatchLogFileHeader header;
+};
+
+#endif // MATCH_LOG_H
@@ -0,0 +1,68 @@
+// MatchRandom.h
+#ifndef MATCH_RANDOM_H
+#define MATCH_RANDOM_H
+
+#include <cstdint>
+
+// Counter based random number generator owned by one simulation.
+// Draw n is the SplitMix64 finalizer applied to seed + n * golden ratio, so the whole
+// state is (seed, counter): seeding is free, the stream can be saved and restored as
+// two integers, and the same seed gives the same draws on every platform. Floats are
+// built from the integer bits, not through <random> distributions, whose results are
+// implementation defined.
+class MatchRandom {
+public:
+    explicit MatchRandom(uint64_t seed = 0) : seed(seed), counter(0) {}
+
+    // Restart the stream of seed
+    void Seed(uint64_t value) {
+        seed = value;
+        counter = 0;
+    }
+
+    uint64_t GetSeed() const { return seed; }
+
+    // Draws taken since the last Seed; setting it back replays the stream from there
+    uint64_t GetCounter() const { return counter; }
+    void SetCounter(uint64_t value) { counter = value; }
+
+    // Uniform 32 bits
+    uint32_t Next() {
+        counter++;
+        return static_cast<uint32_t>(Mix(seed + counter * GOLDEN_GAMMA) >> 32);
+    }
+
+    // Uniform integer in [0, bound), bound > 0
+    uint32_t Below(uint32_t bound) {
+        return static_cast<uint32_t>((static_cast<uint64_t>(Next()) * bound) >> 32);
+    }
+
+    // Uniform float in [0, 1) with 24 bits of precision
+    float NextFloat() {
+        return static_cast<float>(Next() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    // Uniform float in [low, high)
+    float Range(float low, float high) {
+        return low + (high - low) * NextFloat();
+    }
+
+    // Seed for a sub stream, e.g. one match of a server seeded once
+    static uint64_t Derive(uint64_t base, uint64_t stream) {
+        return Mix(base ^ Mix(stream + GOLDEN_GAMMA));
+    }
+
+private:
+    static constexpr uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ull;
+
+    static uint64_t Mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t seed;
+    uint64_t counter;
+};
+
+#endif // MATCH_RANDOM_H
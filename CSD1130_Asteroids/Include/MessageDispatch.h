@@ -0,0 +1,118 @@
+// MessageDispatch.h
+#ifndef MESSAGE_DISPATCH_H
+#define MESSAGE_DISPATCH_H
+
+#include "NetworkProtocol.h"
+#include <atomic>
+#include <functional>
+
+// Read-only view of a received message whose size has already been validated
+template <typename T>
+class MessageView {
+public:
+    MessageView(const void* data, size_t size)
+        : message(static_cast<const T*>(data)), size(size) {
+    }
+
+    const T& Get() const { return *message; }
+    const T* operator->() const { return message; }
+
+    // Whole datagram, header included
+    const void* Data() const { return message; }
+    size_t Size() const { return size; }
+
+    // Variable-length data following the fixed struct
+    const char* Payload() const { return reinterpret_cast<const char*>(message) + sizeof(T); }
+    size_t PayloadSize() const { return size - sizeof(T); }
+
+private:
+    const T* message;
+    size_t size;
+};
+
+// Per message type counters
+struct MessageTypeStats {
+    std::atomic<uint64_t> messages;    // messages received with this type
+    std::atomic<uint64_t> bytes;       // bytes received with this type
+    std::atomic<uint64_t> rejected;    // messages dropped for a size outside the traits range
+
+    MessageTypeStats() : messages(0), bytes(0), rejected(0) {}
+};
+
+// O(1) dispatch table indexed by MessageType.
+// Handlers receive the extra Args (e.g. the sender) followed by a MessageView of the
+// struct declared in MessageTraits. Sizes are checked against the traits before the call,
+// so handlers never see a truncated or oversized message.
+template <typename... Args>
+class MessageDispatcher {
+public:
+    typedef std::function<void(Args..., const void*, size_t)> RawHandler;
+
+    MessageDispatcher() : malformed(0) {}
+
+    template <MessageType Type>
+    void Register(std::function<void(Args..., const MessageView<typename MessageTraits<Type>::Struct>&)> handler) {
+        typedef MessageTraits<Type> Traits;
+
+        Entry& entry = entries[static_cast<uint8_t>(Type)];
+        entry.minSize = Traits::MIN_SIZE;
+        entry.maxSize = Traits::MAX_SIZE;
+        entry.handler = [handler](Args... args, const void* data, size_t size) {
+            handler(args..., MessageView<typename Traits::Struct>(data, size));
+        };
+    }
+
+    // Called with the raw datagram for types without a registered handler
+    void SetFallback(RawHandler handler) { fallback = handler; }
+
+    // Returns true if a registered handler accepted the message
+    bool Dispatch(Args... args, const void* data, size_t size) {
+        if (size < sizeof(NetworkMessage)) {
+            malformed.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        uint8_t type = *static_cast<const uint8_t*>(data);
+        Entry& entry = entries[type];
+
+        MessageTypeStats& typeStats = stats[type];
+        typeStats.messages.fetch_add(1, std::memory_order_relaxed);
+        typeStats.bytes.fetch_add(size, std::memory_order_relaxed);
+
+        if (!entry.handler) {
+            if (fallback) {
+                fallback(args..., data, size);
+            }
+            return false;
+        }
+
+        if (size < entry.minSize || size > entry.maxSize) {
+            typeStats.rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        entry.handler(args..., data, size);
+        return true;
+    }
+
+    const MessageTypeStats& GetStats(MessageType type) const { return stats[static_cast<uint8_t>(type)]; }
+
+    // Datagrams too short to hold a message header
+    uint64_t GetMalformedCount() const { return malformed.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        size_t minSize;
+        size_t maxSize;
+        RawHandler handler;
+
+        Entry() : minSize(0), maxSize(0) {}
+    };
+
+    Entry entries[256];
+    MessageTypeStats stats[256];
+    RawHandler fallback;
+    std::atomic<uint64_t> malformed;
+};
+
+#endif // MESSAGE_DISPATCH_H
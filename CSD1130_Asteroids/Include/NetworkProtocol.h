@@ -0,0 +1,307 @@
+// NetworkProtocol.h
+// Wire format shared by the game server, the game client and the command-line tools.
+// Only depends on the C++ standard library so it can be built on any platform.
+#ifndef NETWORK_PROTOCOL_H
+#define NETWORK_PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// Maximum size for UDP packets
+constexpr size_t MAX_PACKET_SIZE = 1024;
+
+// Largest payload a single UDP datagram can carry
+constexpr size_t MAX_DATAGRAM_SIZE = 65507;
+
+// Largest bundle of coalesced messages. Below the 1500 byte Ethernet MTU so bundles
+// are never fragmented, and within the server receive buffer.
+constexpr size_t MAX_BUNDLE_SIZE = MAX_PACKET_SIZE;
+
+// Client ID type
+typedef uint8_t ClientID;
+
+// Simulation facts a client needs to move objects between snapshots the way the server does.
+// The world is a torus: the 800x600 client view plus a margin, so the largest asteroid is
+// off screen before it wraps.
+constexpr unsigned int SIMULATION_TICK_RATE = 60;
+constexpr float WORLD_VIEW_HALF_WIDTH = 400.0f;
+constexpr float WORLD_VIEW_HALF_HEIGHT = 300.0f;
+constexpr float WORLD_WRAP_MARGIN = 90.0f;
+constexpr float WORLD_MIN_X = -(WORLD_VIEW_HALF_WIDTH + WORLD_WRAP_MARGIN);
+constexpr float WORLD_MAX_X = WORLD_VIEW_HALF_WIDTH + WORLD_WRAP_MARGIN;
+constexpr float WORLD_MIN_Y = -(WORLD_VIEW_HALF_HEIGHT + WORLD_WRAP_MARGIN);
+constexpr float WORLD_MAX_Y = WORLD_VIEW_HALF_HEIGHT + WORLD_WRAP_MARGIN;
+
+// Network message types
+enum class MessageType : uint8_t {
+    CONNECT_REQUEST = 1,
+    CONNECT_ACCEPT = 2,
+    CONNECT_REJECT = 3,
+    DISCONNECT = 4,
+    GAME_STATE = 5,
+    PLAYER_INPUT = 6,
+    GAME_START = 7,
+    GAME_END = 8,
+    HEARTBEAT = 9,
+    BUNDLE = 10,
+    INPUT_FRAME = 11,
+    OBJECT_EVENTS = 12
+};
+
+// Base message structure
+#pragma pack(push, 1)
+struct NetworkMessage {
+    MessageType type;
+    ClientID clientID;
+    uint16_t sequence;
+
+    NetworkMessage() : type(MessageType::HEARTBEAT), clientID(0), sequence(0) {}
+    NetworkMessage(MessageType t, ClientID id, uint16_t seq) : type(t), clientID(id), sequence(seq) {}
+};
+
+// PlayerInputMessage buttons packed into one byte
+enum InputButtons : uint8_t {
+    INPUT_UP = 1 << 0,
+    INPUT_DOWN = 1 << 1,
+    INPUT_LEFT = 1 << 2,
+    INPUT_RIGHT = 1 << 3,
+    INPUT_FIRE = 1 << 4
+};
+
+// PlayerInputMessage inputTick of an input not stamped with a tick, applied from the next
+// tick. 0 is a tick like any other.
+constexpr uint32_t NO_INPUT_TICK = UINT32_MAX;
+
+// Player input message
+struct PlayerInputMessage : NetworkMessage {
+    bool up;
+    bool down;
+    bool left;
+    bool right;
+    bool fire;
+    uint32_t ackTick;       // serverTick of the latest snapshot the client applied
+    uint32_t ackHash;       // client's WorldHash of its view at ackTick, 0 if not checked
+    uint32_t inputTick;     // rollback mode: tick the buttons are for, NO_INPUT_TICK for the next tick
+
+    PlayerInputMessage() : NetworkMessage(MessageType::PLAYER_INPUT, 0, 0),
+        up(false), down(false), left(false), right(false), fire(false), ackTick(0), ackHash(0), inputTick(NO_INPUT_TICK) {
+    }
+
+    uint8_t GetButtons() const {
+        return static_cast<uint8_t>((up ? INPUT_UP : 0) | (down ? INPUT_DOWN : 0) | (left ? INPUT_LEFT : 0) |
+            (right ? INPUT_RIGHT : 0) | (fire ? INPUT_FIRE : 0));
+    }
+
+    void SetButtons(uint8_t buttons) {
+        up = (buttons & INPUT_UP) != 0;
+        down = (buttons & INPUT_DOWN) != 0;
+        left = (buttons & INPUT_LEFT) != 0;
+        right = (buttons & INPUT_RIGHT) != 0;
+        fire = (buttons & INPUT_FIRE) != 0;
+    }
+};
+
+// Ship state data
+struct ShipState {
+    float posX;
+    float posY;
+    float dirCurr;
+    float velocityX;
+    float velocityY;
+    bool active;
+    uint32_t score;
+    uint8_t lives;
+
+    ShipState() : posX(0), posY(0), dirCurr(0), velocityX(0), velocityY(0),
+        active(true), score(0), lives(3) {
+    }
+};
+
+// Asteroid state data
+struct AsteroidState {
+    uint16_t id;            // server entity slot, kept while the object lives
+    float posX;
+    float posY;
+    float velocityX;
+    float velocityY;
+    float scale;
+    bool active;
+
+    AsteroidState() : id(0), posX(0), posY(0), velocityX(0), velocityY(0),
+        scale(1.0f), active(true) {
+    }
+};
+
+// Bullet state data
+struct BulletState {
+    uint16_t id;            // server entity slot, kept while the object lives
+    ClientID ownerID;
+    float posX;
+    float posY;
+    float velocityX;
+    float velocityY;
+    bool active;
+
+    BulletState() : id(0), ownerID(0), posX(0), posY(0), velocityX(0), velocityY(0), active(true) {}
+};
+
+// GameStateMessage flags
+enum GameStateFlags : uint8_t {
+    GAME_STATE_OBJECTS_OMITTED = 1 << 0    // event replication: ships only, counts are 0
+};
+
+// Game state message (the header sequence numbers the snapshots, gaps mean lost packets)
+struct GameStateMessage : NetworkMessage {
+    uint32_t serverTick;    // simulation tick the snapshot was taken after
+    uint8_t playerCount;
+    uint16_t asteroidCount;
+    uint16_t bulletCount;
+    uint8_t gameStatus; // 0 = waiting, 1 = in progress, 2 = game over
+    uint8_t flags;      // GameStateFlags
+    uint32_t worldHash; // WorldHash of the active ships, asteroids and bullets, 0 if not sent;
+                        // covers the objects of the world even when they are omitted
+
+    // Variable-length data follows:
+    // ShipState[playerCount] - ship states
+    // AsteroidState[asteroidCount] - asteroid states
+    // BulletState[bulletCount] - bullet states
+
+    GameStateMessage() : NetworkMessage(MessageType::GAME_STATE, 0, 0),
+        serverTick(0), playerCount(0), asteroidCount(0), bulletCount(0), gameStatus(0), flags(0), worldHash(0) {
+    }
+};
+
+// One tick stamped input relayed in rollback mode
+constexpr size_t INPUT_FRAME_MAX_ENTRIES = 64;      // more inputs in a tick go out as several frames
+
+struct InputFrameEntry {
+    ClientID clientID;
+    uint32_t tick;          // tick the buttons are for, may be in the past
+    uint8_t buttons;        // InputButtons bits
+};
+
+// Rollback mode: sent every tick in place of most snapshots. Relays the player inputs the
+// server received since the previous frame; clients that simulate predict the rest.
+struct InputFrameMessage : NetworkMessage {
+    uint32_t serverTick;    // tick the frame was sent from, the next input is for serverTick + 1
+    uint8_t entryCount;
+
+    // Variable-length data follows:
+    // InputFrameEntry[entryCount]
+
+    InputFrameMessage() : NetworkMessage(MessageType::INPUT_FRAME, 0, 0), serverTick(0), entryCount(0) {}
+};
+
+// Kinds of the records in an ObjectEventsMessage
+enum ObjectEventKind : uint8_t {
+    OBJECT_SPAWN_ASTEROID = 0,
+    OBJECT_SPAWN_BULLET = 1,
+    OBJECT_DESTROY = 2
+};
+
+// A new asteroid or bullet with its state after the message's tick. Until it is destroyed
+// it moves in a straight line: every tick the position adds velocity / SIMULATION_TICK_RATE,
+// and asteroids wrap at the world bounds like the server does.
+struct ObjectSpawnRecord {
+    ObjectEventKind kind;   // OBJECT_SPAWN_ASTEROID or OBJECT_SPAWN_BULLET
+    uint16_t id;            // as AsteroidState and BulletState
+    ClientID ownerID;       // bullets
+    float posX;
+    float posY;
+    float velocityX;
+    float velocityY;
+    float scale;            // asteroids
+};
+
+struct ObjectDestroyRecord {
+    ObjectEventKind kind;   // OBJECT_DESTROY
+    uint16_t id;
+};
+
+// Event replication: asteroids and bullets that appeared or went during a tick. The header
+// sequence numbers these messages; after a gap a client's copy is stale until the next
+// snapshot that carries the objects.
+struct ObjectEventsMessage : NetworkMessage {
+    uint32_t serverTick;    // tick the events happened in
+    uint16_t eventCount;
+
+    // Variable-length data follows:
+    // eventCount records, ObjectSpawnRecord or ObjectDestroyRecord by their kind
+
+    ObjectEventsMessage() : NetworkMessage(MessageType::OBJECT_EVENTS, 0, 0), serverTick(0), eventCount(0) {}
+};
+
+// Connection accept message
+struct ConnectAcceptMessage : NetworkMessage {
+    ClientID assignedID;
+    uint8_t totalPlayers;
+
+    ConnectAcceptMessage() : NetworkMessage(MessageType::CONNECT_ACCEPT, 0, 0),
+        assignedID(0), totalPlayers(0) {
+    }
+};
+
+// Game end message
+struct GameEndMessage : NetworkMessage {
+    ClientID winnerID;
+    uint32_t winnerScore;
+    uint32_t scores[4]; // Array of scores for all players
+
+    GameEndMessage() : NetworkMessage(MessageType::GAME_END, 0, 0),
+        winnerID(0), winnerScore(0) {
+        for (int i = 0; i < 4; i++) scores[i] = 0;
+    }
+};
+
+// Several messages to the same peer packed into one datagram (see PacketBuilder.h).
+// The header sequence counts the datagrams flushed to the peer.
+struct BundleMessage : NetworkMessage {
+    uint8_t messageCount;
+
+    // Variable-length data follows:
+    // messageCount times { uint16_t size; message bytes[size] }
+
+    BundleMessage() : NetworkMessage(MessageType::BUNDLE, 0, 0), messageCount(0) {}
+};
+#pragma pack(pop)
+
+// ---------------------------------------------------------------------------
+// Message traits: the struct and the accepted wire size range of every message type.
+// A new message type needs an enum value, its struct and one DECLARE_MESSAGE line;
+// the dispatchers pick it up from here.
+
+template <MessageType Type>
+struct MessageTraits;
+
+#define DECLARE_MESSAGE(TYPE, STRUCT, MAX_SIZE_BYTES)                                           \
+    template <>                                                                                 \
+    struct MessageTraits<MessageType::TYPE> {                                                   \
+        typedef STRUCT Struct;                                                                  \
+        static constexpr size_t MIN_SIZE = sizeof(STRUCT);                                      \
+        static constexpr size_t MAX_SIZE = (MAX_SIZE_BYTES);                                    \
+        static_assert(std::is_base_of<NetworkMessage, STRUCT>::value,                           \
+            #STRUCT " must start with the NetworkMessage header");                              \
+        static_assert(MIN_SIZE <= MAX_SIZE, #TYPE " maximum size is below its struct size");   \
+        static_assert(MAX_SIZE <= MAX_DATAGRAM_SIZE, #TYPE " does not fit in a datagram");      \
+    }
+
+DECLARE_MESSAGE(CONNECT_REQUEST, NetworkMessage, sizeof(NetworkMessage));
+DECLARE_MESSAGE(CONNECT_ACCEPT, ConnectAcceptMessage, sizeof(ConnectAcceptMessage));
+DECLARE_MESSAGE(CONNECT_REJECT, NetworkMessage, sizeof(NetworkMessage));
+DECLARE_MESSAGE(DISCONNECT, NetworkMessage, sizeof(NetworkMessage));
+DECLARE_MESSAGE(GAME_STATE, GameStateMessage, MAX_DATAGRAM_SIZE);  // variable-length entity arrays follow
+DECLARE_MESSAGE(PLAYER_INPUT, PlayerInputMessage, sizeof(PlayerInputMessage));
+DECLARE_MESSAGE(GAME_START, NetworkMessage, sizeof(NetworkMessage));
+DECLARE_MESSAGE(GAME_END, GameEndMessage, sizeof(GameEndMessage));
+DECLARE_MESSAGE(HEARTBEAT, NetworkMessage, sizeof(NetworkMessage));
+DECLARE_MESSAGE(BUNDLE, BundleMessage, MAX_BUNDLE_SIZE);
+DECLARE_MESSAGE(INPUT_FRAME, InputFrameMessage,
+    sizeof(InputFrameMessage) + INPUT_FRAME_MAX_ENTRIES * sizeof(InputFrameEntry));
+DECLARE_MESSAGE(OBJECT_EVENTS, ObjectEventsMessage, MAX_PACKET_SIZE);
+
+// Client to server messages must fit the receive buffers
+static_assert(MessageTraits<MessageType::PLAYER_INPUT>::MAX_SIZE <= MAX_PACKET_SIZE, "input message too large");
+static_assert(MessageTraits<MessageType::BUNDLE>::MAX_SIZE <= MAX_PACKET_SIZE, "bundle message too large");
+
+#endif // NETWORK_PROTOCOL_H
@@ -0,0 +1,222 @@
+// ObjectReplica.h
+// Client copy of the server's asteroids and bullets under event replication. Only depends
+// on the protocol and the C++ standard library so the tools can use it too.
+#ifndef OBJECT_REPLICA_H
+#define OBJECT_REPLICA_H
+
+#include "NetworkProtocol.h"
+#include "WorldHash.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Asteroids and bullets only change when they appear or go; in between they fly straight
+// and asteroids wrap. The replica starts from a snapshot that carries the objects, applies
+// OBJECT_EVENTS on top and moves everything forward tick by tick the way the server does,
+// so a snapshot without the objects can still be checked against its world hash. The
+// steps are the float server's to the bit; a SIM_FIXED_POINT server rounds its steps
+// differently and its hashes only match the replica right after a correction.
+// Not thread safe.
+class ObjectReplica {
+public:
+    struct Object {
+        uint16_t id;
+        uint8_t kind;       // WorldHashKind: WORLD_HASH_ASTEROID or WORLD_HASH_BULLET
+        ClientID ownerID;
+        float posX;
+        float posY;
+        float velocityX;
+        float velocityY;
+        float scale;
+    };
+
+    ObjectReplica() : tick(0), valid(false) {}
+
+    // Valid from a snapshot with the objects until Invalidate, after a lost event message
+    bool IsValid() const { return valid; }
+    void Invalidate() { valid = false; }
+
+    uint32_t GetTick() const { return tick; }
+    size_t GetObjectCount() const { return objects.size(); }
+    const std::vector<Object>& GetObjects() const { return objects; }
+
+    // Replaces every object with the ones of a GAME_STATE message. Returns false, leaving
+    // the replica as it was, for a truncated message or one without the objects.
+    bool ApplySnapshot(const void* data, size_t size) {
+        GameStateMessage msg;
+        if (size < sizeof(msg)) {
+            return false;
+        }
+        std::memcpy(&msg, data, sizeof(msg));
+        if ((msg.flags & GAME_STATE_OBJECTS_OMITTED) != 0) {
+            return false;
+        }
+
+        size_t expected = sizeof(msg) + msg.playerCount * sizeof(ShipState) +
+            msg.asteroidCount * sizeof(AsteroidState) + msg.bulletCount * sizeof(BulletState);
+        if (size < expected) {
+            return false;
+        }
+
+        Clear();
+        const char* cursor = static_cast<const char*>(data) + sizeof(msg) + msg.playerCount * sizeof(ShipState);
+        for (int i = 0; i < msg.asteroidCount; i++, cursor += sizeof(AsteroidState)) {
+            AsteroidState asteroid;
+            std::memcpy(&asteroid, cursor, sizeof(asteroid));
+            if (asteroid.active) {
+                Object& object = Insert(asteroid.id);
+                object.kind = WORLD_HASH_ASTEROID;
+                object.ownerID = 0;
+                object.posX = asteroid.posX;
+                object.posY = asteroid.posY;
+                object.velocityX = asteroid.velocityX;
+                object.velocityY = asteroid.velocityY;
+                object.scale = asteroid.scale;
+            }
+        }
+        for (int i = 0; i < msg.bulletCount; i++, cursor += sizeof(BulletState)) {
+            BulletState bullet;
+            std::memcpy(&bullet, cursor, sizeof(bullet));
+            if (bullet.active) {
+                Object& object = Insert(bullet.id);
+                object.kind = WORLD_HASH_BULLET;
+                object.ownerID = bullet.ownerID;
+                object.posX = bullet.posX;
+                object.posY = bullet.posY;
+                object.velocityX = bullet.velocityX;
+                object.velocityY = bullet.velocityY;
+                object.scale = 0.0f;
+            }
+        }
+
+        tick = msg.serverTick;
+        valid = true;
+        return true;
+    }
+
+    // Applies an OBJECT_EVENTS message. Events older than the replica were already in the
+    // snapshot it started from and are skipped. Returns false for a truncated message.
+    bool ApplyEvents(const void* data, size_t size) {
+        ObjectEventsMessage msg;
+        if (size < sizeof(msg)) {
+            return false;
+        }
+        std::memcpy(&msg, data, sizeof(msg));
+        if (!valid || msg.serverTick < tick) {
+            return true;
+        }
+        AdvanceTo(msg.serverTick);
+
+        const char* cursor = static_cast<const char*>(data) + sizeof(msg);
+        const char* end = static_cast<const char*>(data) + size;
+        for (int i = 0; i < msg.eventCount; i++) {
+            if (cursor >= end) {
+                return false;
+            }
+
+            ObjectEventKind kind = static_cast<ObjectEventKind>(*cursor);
+            if (kind == OBJECT_DESTROY) {
+                ObjectDestroyRecord record;
+                if (end - cursor < static_cast<ptrdiff_t>(sizeof(record))) {
+                    return false;
+                }
+                std::memcpy(&record, cursor, sizeof(record));
+                cursor += sizeof(record);
+                Remove(record.id);
+            }
+            else if (kind == OBJECT_SPAWN_ASTEROID || kind == OBJECT_SPAWN_BULLET) {
+                ObjectSpawnRecord record;
+                if (end - cursor < static_cast<ptrdiff_t>(sizeof(record))) {
+                    return false;
+                }
+                std::memcpy(&record, cursor, sizeof(record));
+                cursor += sizeof(record);
+
+                Object& object = Insert(record.id);
+                object.kind = kind == OBJECT_SPAWN_ASTEROID ? WORLD_HASH_ASTEROID : WORLD_HASH_BULLET;
+                object.ownerID = record.ownerID;
+                object.posX = record.posX;
+                object.posY = record.posY;
+                object.velocityX = record.velocityX;
+                object.velocityY = record.velocityY;
+                object.scale = record.scale;
+            }
+            else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Moves every object forward to a later tick, one server tick at a time
+    void AdvanceTo(uint32_t target) {
+        const float dt = 1.0f / SIMULATION_TICK_RATE;
+        const float rangeX = WORLD_MAX_X - WORLD_MIN_X;
+        const float rangeY = WORLD_MAX_Y - WORLD_MIN_Y;
+
+        for (; tick < target; tick++) {
+            for (Object& object : objects) {
+                float x = object.posX + object.velocityX * dt;
+                float y = object.posY + object.velocityY * dt;
+
+                // Bullets expire before they reach an edge, like on the server
+                if (object.kind == WORLD_HASH_ASTEROID) {
+                    if (x < WORLD_MIN_X) x = x + rangeX;
+                    else if (x > WORLD_MAX_X) x = x - rangeX;
+                    if (y < WORLD_MIN_Y) y = y + rangeY;
+                    else if (y > WORLD_MAX_Y) y = y - rangeY;
+                }
+
+                object.posX = x;
+                object.posY = y;
+            }
+        }
+    }
+
+    void AddToHash(WorldHash& hash) const {
+        for (const Object& object : objects) {
+            hash.Add(object.kind, object.posX, object.posY, object.velocityX, object.velocityY);
+        }
+    }
+
+private:
+    static constexpr uint32_t NO_OBJECT = UINT32_MAX;
+
+    void Clear() {
+        objects.clear();
+        indexOfId.assign(indexOfId.size(), NO_OBJECT);
+    }
+
+    // The object with an id, added when missing
+    Object& Insert(uint16_t id) {
+        if (id >= indexOfId.size()) {
+            indexOfId.resize(id + 1u, NO_OBJECT);
+        }
+        if (indexOfId[id] == NO_OBJECT) {
+            indexOfId[id] = static_cast<uint32_t>(objects.size());
+            objects.push_back(Object());
+            objects.back().id = id;
+        }
+        return objects[indexOfId[id]];
+    }
+
+    // Swap with the last object and pop, the order does not matter to the hash
+    void Remove(uint16_t id) {
+        if (id >= indexOfId.size() || indexOfId[id] == NO_OBJECT) {
+            return;
+        }
+        uint32_t index = indexOfId[id];
+        objects[index] = objects.back();
+        indexOfId[objects[index].id] = index;
+        objects.pop_back();
+        indexOfId[id] = NO_OBJECT;
+    }
+
+    std::vector<Object> objects;
+    std::vector<uint32_t> indexOfId;    // object id (server entity slot) -> index in objects
+    uint32_t tick;
+    bool valid;
+};
+
+#endif // OBJECT_REPLICA_H
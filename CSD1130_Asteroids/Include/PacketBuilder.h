@@ -0,0 +1,120 @@
+// PacketBuilder.h
+// Coalescing of small messages into BUNDLE datagrams.
+// Only depends on the C++ standard library so the tools can use it as well.
+#ifndef PACKET_BUILDER_H
+#define PACKET_BUILDER_H
+
+#include "NetworkProtocol.h"
+#include <cstring>
+#include <vector>
+
+// Size prefix written in front of every bundled message
+typedef uint16_t BundleLength;
+
+// Outgoing datagram for one peer. Messages are appended until the next one would
+// not fit, then the owner sends Finish() and starts over with Clear().
+class PacketBuilder {
+public:
+    PacketBuilder() : messageCount(0) {}
+
+    // Messages bigger than this are never bundled and go out on their own
+    static constexpr size_t MAX_BUNDLED_MESSAGE = MAX_BUNDLE_SIZE - sizeof(BundleMessage) - sizeof(BundleLength);
+
+    static bool CanBundle(size_t size) { return size <= MAX_BUNDLED_MESSAGE; }
+
+    bool Empty() const { return messageCount == 0; }
+    size_t MessageCount() const { return messageCount; }
+
+    // Returns false if the message does not fit into the remaining space
+    bool Append(const void* data, size_t size) {
+        size_t used = buffer.empty() ? sizeof(BundleMessage) : buffer.size();
+        if (!CanBundle(size) || messageCount == UINT8_MAX ||
+            used + sizeof(BundleLength) + size > MAX_BUNDLE_SIZE) {
+            return false;
+        }
+
+        if (buffer.empty()) {
+            buffer.reserve(MAX_BUNDLE_SIZE);
+            buffer.resize(sizeof(BundleMessage));
+        }
+
+        BundleLength length = static_cast<BundleLength>(size);
+        size_t offset = buffer.size();
+        buffer.resize(offset + sizeof(length) + size);
+        memcpy(buffer.data() + offset, &length, sizeof(length));
+        memcpy(buffer.data() + offset + sizeof(length), data, size);
+        messageCount++;
+        return true;
+    }
+
+    // Datagram to send. A single message goes out as is, without the bundle header.
+    const char* Finish(uint16_t sequence, size_t& size) {
+        if (messageCount == 1) {
+            size = buffer.size() - sizeof(BundleMessage) - sizeof(BundleLength);
+            return buffer.data() + sizeof(BundleMessage) + sizeof(BundleLength);
+        }
+
+        BundleMessage header;
+        header.sequence = sequence;
+        header.messageCount = static_cast<uint8_t>(messageCount);
+        memcpy(buffer.data(), &header, sizeof(header));
+
+        size = buffer.size();
+        return buffer.data();
+    }
+
+    // Keeps the allocation for the next datagram
+    void Clear() {
+        buffer.clear();
+        messageCount = 0;
+    }
+
+private:
+    std::vector<char> buffer;
+    size_t messageCount;
+};
+
+// Calls handler(data, size) for every message inside a bundle.
+// The whole bundle is validated first, so a truncated bundle delivers nothing;
+// nested bundles are rejected. Returns false for malformed bundles.
+template <typename Handler>
+bool ForEachBundledMessage(const void* bundle, size_t size, Handler handler) {
+    if (size < sizeof(BundleMessage)) {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(bundle);
+    BundleMessage header;
+    memcpy(&header, data, sizeof(header));
+
+    size_t offset = sizeof(BundleMessage);
+    for (uint8_t i = 0; i < header.messageCount; i++) {
+        BundleLength length;
+        if (offset + sizeof(length) > size) {
+            return false;
+        }
+        memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+
+        if (length < sizeof(NetworkMessage) || offset + length > size ||
+            static_cast<MessageType>(data[offset]) == MessageType::BUNDLE) {
+            return false;
+        }
+        offset += length;
+    }
+    if (offset != size) {
+        return false;
+    }
+
+    offset = sizeof(BundleMessage);
+    for (uint8_t i = 0; i < header.messageCount; i++) {
+        BundleLength length;
+        memcpy(&length, data + offset, sizeof(length));
+        offset += sizeof(length);
+        handler(data + offset, static_cast<size_t>(length));
+        offset += length;
+    }
+    return true;
+}
+
+#endif // PACKET_BUILDER_H
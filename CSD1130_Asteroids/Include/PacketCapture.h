@@ -0,0 +1,96 @@
+// PacketCapture.h
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+// Capture file layout:
+//   CaptureFileHeader
+//   repeated { CaptureRecordHeader, payload[size] }
+// All fields are little-endian, exactly as the x86/x64 server writes them.
+
+constexpr uint32_t CAPTURE_MAGIC = 0x50414341; // "ACAP"
+constexpr uint16_t CAPTURE_VERSION = 1;
+
+// What a capture record describes
+enum class CaptureDirection : uint8_t {
+    INBOUND = 0,    // datagram received by the server
+    OUTBOUND = 1,   // datagram sent by the server
+    TICK = 2        // GameServer::Update call, payload is the float dt
+};
+
+#pragma pack(push, 1)
+struct CaptureFileHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+
+    CaptureFileHeader() : magic(CAPTURE_MAGIC), version(CAPTURE_VERSION), reserved(0) {}
+};
+
+struct CaptureRecordHeader {
+    uint64_t timestampUs;   // microseconds since the capture was started
+    uint32_t address;       // peer IPv4 address (network byte order), 0 for ticks
+    uint16_t port;          // peer port (network byte order), 0 for ticks
+    uint8_t clientID;       // connection ID, 0 if the peer is not connected yet
+    CaptureDirection direction;
+    uint16_t size;          // payload size in bytes
+};
+#pragma pack(pop)
+
+// Append-only capture writer.
+// Records are packed into an in-memory buffer and written out in large blocks,
+// so the network thread only pays for a memcpy under a short lock.
+class PacketCaptureWriter {
+public:
+    PacketCaptureWriter();
+    ~PacketCaptureWriter();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    // Checked before every Write without taking the lock
+    bool IsOpen() const { return isOpen.load(std::memory_order_acquire); }
+
+    // Datagrams larger than the 16-bit record size cannot be recorded and are left out;
+    // counted since Open, and reported by Close
+    void Write(CaptureDirection direction, uint32_t address, uint16_t port,
+        uint8_t clientID, const void* data, size_t size);
+    uint64_t GetDroppedRecordCount() const { return droppedRecords.load(std::memory_order_relaxed); }
+
+private:
+    void FlushLocked();
+
+    static constexpr size_t FLUSH_THRESHOLD = 256 * 1024;
+
+    FILE* file;                     // guarded by writeMutex
+    std::atomic<bool> isOpen;
+    std::atomic<uint64_t> droppedRecords;
+    std::vector<char> buffer;
+    std::chrono::steady_clock::time_point startTime;
+    std::mutex writeMutex;
+};
+
+// Sequential capture reader used by the replay tool
+class PacketCaptureReader {
+public:
+    PacketCaptureReader();
+    ~PacketCaptureReader();
+
+    bool Open(const std::string& path);
+    void Close();
+
+    // Read the next record; returns false at end of file or on a truncated record
+    bool Next(CaptureRecordHeader& header, std::vector<char>& payload);
+
+private:
+    FILE* file;
+};
+
+#endif // PACKET_CAPTURE_H
@@ -0,0 +1,67 @@
+// RingBuffer.h
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+// Fixed capacity FIFO stored inline, no allocations.
+// Elements are pushed at the back and popped at the front, so a ring of things created in
+// order with the same lifetime expires from the front without searching. Copying the ring
+// copies the inline block, which keeps it cheap to save with the rest of the world state.
+// Capacity is a power of two so positions wrap with a mask.
+template <typename T, unsigned int N>
+class RingBuffer {
+    static_assert(N > 0 && (N & (N - 1)) == 0, "ring capacity must be a power of two");
+
+public:
+    static constexpr unsigned int CAPACITY = N;
+
+    RingBuffer() : head(0), count(0) {}
+
+    unsigned int size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    void clear() { head = 0; count = 0; }
+
+    // i-th oldest element, 0 is the front
+    T& operator[](unsigned int i) { return items[(head + i) & (N - 1)]; }
+    const T& operator[](unsigned int i) const { return items[(head + i) & (N - 1)]; }
+
+    T& front() { return items[head]; }
+    const T& front() const { return items[head]; }
+
+    // The ring must not be full
+    void push_back(const T& value) {
+        items[(head + count) & (N - 1)] = value;
+        count++;
+    }
+
+    // The ring must not be empty
+    void pop_front() {
+        head = (head + 1) & (N - 1);
+        count--;
+    }
+
+    // Removes the elements pred is true for, the rest close up in the same order.
+    // Returns the number removed.
+    template <typename Pred>
+    unsigned int remove_if(Pred pred) {
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            if (!pred((*this)[i])) {
+                if (kept != i) {
+                    (*this)[kept] = (*this)[i];
+                }
+                kept++;
+            }
+        }
+        unsigned int removed = count - kept;
+        count = kept;
+        return removed;
+    }
+
+private:
+    T items[N];
+    unsigned int head;
+    unsigned int count;
+};
+
+#endif // RING_BUFFER_H
@@ -0,0 +1,44 @@
+// ServerTools.h
+#ifndef SERVER_TOOLS_H
+#define SERVER_TOOLS_H
+
+// Benchmarks and checks of the server code, run from the command line (see Main.cpp).
+// Each one sets up its own objects, prints its results to std::cout and leaves nothing
+// behind. Numbers depend on the build, compare runs of the same configuration.
+class GameServer;
+
+class ServerTools {
+public:
+    // Collision time per tick of the server's broadphase and narrowphase, from a hundred
+    // to tens of thousands of entities, against testing every pair
+    static void RunCollisionBenchmark();
+
+    // EntityStore::Integrate against the per entity loop it replaced: checks that 600 ticks
+    // give bit identical positions and boxes, then times a pass over 2048 and 100000
+    // entities. Returns false if the results differ.
+    static bool RunIntegrateBenchmark();
+
+    // CollisionIntersection_RectRectBatch against the scalar test on every candidate: random
+    // pairs, touching edges, zero and equal velocities, -0, infinities and NaN, over several
+    // time steps. Returns false unless the hits and the bits of every time are the same.
+    static bool RunSweptBatchCheck();
+
+    // Time per pair of the swept narrowphase tests, box against box one at a time and
+    // batched and circle against circle, on broadphase-like candidates and on misses only
+    static void RunShapePairBenchmark();
+
+    // Rollback mode on a headless server: a late input rewinds the world across the tick a
+    // match ends in. Passes if the world was rewound and the clients were told of the end
+    // exactly once; gameEnds is the number of GAME_END messages sent. Set the seed first.
+    static bool RunRollbackGameEndCheck(GameServer& server, unsigned int& gameEnds);
+
+    // Time per tick of a seeded world of four players with scripted inputs and a few hundred
+    // to a thousand asteroids. Build with and without SIM_FIXED_POINT to compare the two.
+    static void RunStepBenchmark();
+
+private:
+    // Empties the world of a server without a socket, the messages it sends are only counted
+    static bool StartHeadless(GameServer& server);
+};
+
+#endif // SERVER_TOOLS_H
@@ -0,0 +1,61 @@
+// SimScalar.h
+// Number type of the server simulation. Define SIM_FIXED_POINT to run ship controls,
+// integration, wrapping and the narrowphase on 16.16 fixed point, which gives the same
+// bits on every build and CPU, the precondition for lockstep peers that exchange only
+// inputs. The default float build is unchanged. Simulation code uses the Sim* names
+// below so it compiles either way; anything that leaves the simulation (snapshots,
+// bounding boxes, transforms) converts with SimToFloat.
+#ifndef SIM_SCALAR_H
+#define SIM_SCALAR_H
+
+#include "AEEngine.h"
+#include "FixedPoint.h"
+#include "MatchRandom.h"
+
+#ifdef SIM_FIXED_POINT
+
+typedef Fixed SimScalar;
+typedef FixedVec2 SimVec2;
+
+inline SimScalar SimFromFloat(float value) { return Fixed(value); }
+inline float SimToFloat(SimScalar value) { return value.ToFloat(); }
+
+inline SimScalar SimSin(SimScalar angle) { return FixedSin(angle); }
+inline SimScalar SimCos(SimScalar angle) { return FixedCos(angle); }
+inline SimScalar SimLength(SimScalar x, SimScalar y) { return FixedLength(x, y); }
+
+// Into [-PI, PI] like AEWrap
+inline SimScalar SimWrapAngle(SimScalar angle) { return FixedWrap(angle, -FIXED_PI, FIXED_PI); }
+
+// Same draw as MatchRandom::Range, scaled without float math
+inline SimScalar SimRange(MatchRandom& random, float low, float high) {
+    Fixed fraction = Fixed::FromRaw(static_cast<int32_t>(random.Next() >> (32 - Fixed::FRACTION_BITS)));
+    return Fixed(low) + (Fixed(high) - Fixed(low)) * fraction;
+}
+
+#else
+
+typedef float SimScalar;
+typedef AEVec2 SimVec2;
+
+inline SimScalar SimFromFloat(float value) { return value; }
+inline float SimToFloat(SimScalar value) { return value; }
+
+inline SimScalar SimSin(SimScalar angle) { return sinf(angle); }
+inline SimScalar SimCos(SimScalar angle) { return cosf(angle); }
+inline SimScalar SimLength(SimScalar x, SimScalar y) { return sqrtf(x * x + y * y); }
+
+inline SimScalar SimWrapAngle(SimScalar angle) { return AEWrap(angle, -PI, PI); }
+
+inline SimScalar SimRange(MatchRandom& random, float low, float high) { return random.Range(low, high); }
+
+#endif
+
+inline SimVec2 MakeSimVec2(SimScalar x, SimScalar y) {
+    SimVec2 result;
+    result.x = x;
+    result.y = y;
+    return result;
+}
+
+#endif // SIM_SCALAR_H
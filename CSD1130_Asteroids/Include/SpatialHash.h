@@ -0,0 +1,168 @@
+// SpatialHash.h
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include "Collision.h"
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+// Uniform grid broadphase, rebuilt from scratch every tick.
+// Grid cells are hashed into a bucket table that is filled with a counting sort, so a
+// rebuild is two linear passes with no per-cell allocations. Different cells can share
+// a bucket; that only adds candidates, which the narrowphase rejects.
+//
+// With SetWorld the grid treats the world as a torus. Boxes are inserted once, where they
+// are; a query box near an edge is also looked up shifted by the world size, near enough
+// that it may reach a box hanging over the opposite edge. Candidates come with the offset
+// to add to the inserted box to bring it next to the query box, once per offset.
+//
+// Usage per tick: Clear, Insert every box, Build, then Query any number of boxes.
+class SpatialHash {
+public:
+    explicit SpatialHash(float cellSize = 64.0f);
+
+    // Pick a cell size around the size of the common objects; call before inserting
+    void SetCellSize(float size);
+
+    // Wrap around at the edges of bounds; objects are expected to stay within them
+    void SetWorld(const AABB& bounds);
+
+    void Clear();
+
+    // handle is a small caller index (e.g. a position in the caller's object array)
+    void Insert(uint32_t handle, const AABB& box);
+
+    void Build();
+
+    // Calls visit(handle, offset) for every inserted box sharing a cell with box or one
+    // of its wrapped copies. visit returns false to stop the query early; Query then
+    // returns false.
+    template <typename Visitor>
+    bool Query(const AABB& box, Visitor visit);
+
+    size_t GetItemCount() const { return items.size() + oversized.size(); }
+
+private:
+    struct Item {
+        uint32_t handle;
+        int32_t minX, minY, maxX, maxY;     // covered cell range
+
+        bool Overlaps(int32_t cellMinX, int32_t cellMinY, int32_t cellMaxX, int32_t cellMaxY) const {
+            return minX <= cellMaxX && maxX >= cellMinX && minY <= cellMaxY && maxY >= cellMinY;
+        }
+    };
+
+    int32_t CellCoord(float value) const { return static_cast<int32_t>(std::floor(value * invCellSize)); }
+
+    uint32_t Bucket(int32_t cellX, int32_t cellY) const {
+        uint32_t hash = static_cast<uint32_t>(cellX) * 73856093u ^ static_cast<uint32_t>(cellY) * 19349663u;
+        return hash & bucketMask;
+    }
+
+    // Shifts of a query box that can reach boxes across the world edges, {0, 0} first
+    static constexpr int MAX_WRAP_SHIFTS = 9;
+    int WrapShifts(const AABB& box, AEVec2 shifts[MAX_WRAP_SHIFTS]) const;
+
+    template <typename Visitor>
+    bool QueryCells(const AABB& box, float shiftX, float shiftY, Visitor& visit);
+
+    bool Visit(uint32_t item);
+
+    // Boxes spanning more cells than this per axis are kept in a list every query sees
+    static constexpr int32_t MAX_CELL_SPAN = 16;
+
+    float invCellSize;
+    bool wrap;
+    AABB world;
+    AABB overhang;                          // farthest the inserted boxes reach past each edge
+    std::vector<Item> items;
+    std::vector<Item> oversized;            // boxes too large for the grid
+    std::vector<uint32_t> bucketStart;      // bucketCount + 1 offsets into cellItems
+    std::vector<uint32_t> cellItems;        // item indices sorted by bucket
+    std::vector<uint32_t> scatterCursor;    // Build scratch, kept to reuse the allocation
+    uint32_t bucketMask;
+
+    // Per item stamp of the last query pass that returned it, removes duplicates from
+    // boxes covering several queried cells. Every shift of a query is a pass of its own.
+    std::vector<uint32_t> visitStamp;
+    uint32_t queryStamp;
+};
+
+template <typename Visitor>
+bool SpatialHash::Query(const AABB& box, Visitor visit) {
+    AEVec2 shifts[MAX_WRAP_SHIFTS];
+    int shiftCount = WrapShifts(box, shifts);
+
+    for (int s = 0; s < shiftCount; s++) {
+        if (++queryStamp == 0) {
+            // Stamp wrapped around, forget every old visit
+            std::fill(visitStamp.begin(), visitStamp.end(), 0u);
+            queryStamp = 1;
+        }
+
+        if (!QueryCells(box, shifts[s].x, shifts[s].y, visit)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Visitor>
+bool SpatialHash::QueryCells(const AABB& box, float shiftX, float shiftY, Visitor& visit) {
+    // The candidate is reported relative to the unshifted query box
+    AEVec2 offset;
+    offset.x = -shiftX;
+    offset.y = -shiftY;
+
+    int32_t minX = CellCoord(box.min.x + shiftX), maxX = CellCoord(box.max.x + shiftX);
+    int32_t minY = CellCoord(box.min.y + shiftY), maxY = CellCoord(box.max.y + shiftY);
+
+    for (const Item& item : oversized) {
+        if (item.Overlaps(minX, minY, maxX, maxY) && !visit(item.handle, offset)) {
+            return false;
+        }
+    }
+
+    // A query larger than the grid can hold would visit every bucket many times over
+    if (maxX - minX >= MAX_CELL_SPAN || maxY - minY >= MAX_CELL_SPAN) {
+        for (const Item& item : items) {
+            if (item.Overlaps(minX, minY, maxX, maxY) && !visit(item.handle, offset)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    if (cellItems.empty()) {
+        return true;
+    }
+
+    // A bucket also holds other cells that hash to it, and with them boxes nowhere near
+    // this shift of the query: they are skipped before the stamp, so the shift that does
+    // reach them still reports them
+    for (int32_t y = minY; y <= maxY; y++) {
+        for (int32_t x = minX; x <= maxX; x++) {
+            uint32_t bucket = Bucket(x, y);
+            for (uint32_t i = bucketStart[bucket]; i < bucketStart[bucket + 1]; i++) {
+                uint32_t index = cellItems[i];
+                if (items[index].Overlaps(minX, minY, maxX, maxY) && Visit(index) &&
+                    !visit(items[index].handle, offset)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+inline bool SpatialHash::Visit(uint32_t item) {
+    if (visitStamp[item] == queryStamp) {
+        return false;
+    }
+    visitStamp[item] = queryStamp;
+    return true;
+}
+
+#endif // SPATIAL_HASH_H
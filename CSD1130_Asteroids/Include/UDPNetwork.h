@@ -17,135 +17,52 @@
 #include <atomic>
 #include <mutex>
 #include <map>
+#include <unordered_map>
 #include <queue>
 #include <functional>
 
-// Maximum size for UDP packets
-constexpr size_t MAX_PACKET_SIZE = 1024;
-
-// Client ID type
-typedef uint8_t ClientID;
-
-// Network message types
-enum class MessageType : uint8_t {
-    CONNECT_REQUEST = 1,
-    CONNECT_ACCEPT = 2,
-    CONNECT_REJECT = 3,
-    DISCONNECT = 4,
-    GAME_STATE = 5,
-    PLAYER_INPUT = 6,
-    GAME_START = 7,
-    GAME_END = 8,
-    HEARTBEAT = 9
-};
-
-// Base message structure
-#pragma pack(push, 1)
-struct NetworkMessage {
-    MessageType type;
-    ClientID clientID;
-    uint16_t sequence;
-
-    NetworkMessage() : type(MessageType::HEARTBEAT), clientID(0), sequence(0) {}
-    NetworkMessage(MessageType t, ClientID id, uint16_t seq) : type(t), clientID(id), sequence(seq) {}
-};
-
-// Player input message
-struct PlayerInputMessage : NetworkMessage {
-    bool up;
-    bool down;
-    bool left;
-    bool right;
-    bool fire;
-
-    PlayerInputMessage() : NetworkMessage(MessageType::PLAYER_INPUT, 0, 0),
-        up(false), down(false), left(false), right(false), fire(false) {
+#include "NetworkProtocol.h"
+#include "MessageDispatch.h"
+#include "PacketCapture.h"
+#include "PacketBuilder.h"
+
+// Inbound rate limit settings, applied to every connection
+struct RateLimitConfig {
+    bool enabled;
+    float packetsPerSecond;         // sustained packet rate
+    float packetBurst;              // packet bucket size
+    float bytesPerSecond;           // sustained byte rate
+    float byteBurst;                // byte bucket size
+    bool disconnectAbusive;         // disconnect clients that keep exceeding the limit
+    uint32_t abuseDropsPerSecond;   // drops within one second that count as abuse
+
+    RateLimitConfig() : enabled(true), packetsPerSecond(200.0f), packetBurst(100.0f),
+        bytesPerSecond(32.0f * 1024.0f), byteBurst(16.0f * 1024.0f),
+        disconnectAbusive(false), abuseDropsPerSecond(500) {
     }
 };
 
-// Ship state data
-struct ShipState {
-    float posX;
-    float posY;
-    float dirCurr;
-    float velocityX;
-    float velocityY;
-    bool active;
-    uint32_t score;
-    uint8_t lives;
-
-    ShipState() : posX(0), posY(0), dirCurr(0), velocityX(0), velocityY(0),
-        active(true), score(0), lives(3) {
+// Token buckets and drop counters of one connection
+struct ClientRateLimit {
+    float packetTokens;
+    float byteTokens;
+    std::chrono::steady_clock::time_point lastRefill;
+    uint64_t droppedPackets;
+    uint64_t droppedBytes;
+    uint32_t windowDrops;           // drops since windowStart
+    std::chrono::steady_clock::time_point windowStart;
+
+    ClientRateLimit() : packetTokens(0.0f), byteTokens(0.0f), droppedPackets(0), droppedBytes(0),
+        windowDrops(0) {
     }
 };
 
-// Asteroid state data
-struct AsteroidState {
-    uint16_t id;
-    float posX;
-    float posY;
-    float velocityX;
-    float velocityY;
-    float scale;
-    bool active;
-
-    AsteroidState() : id(0), posX(0), posY(0), velocityX(0), velocityY(0),
-        scale(1.0f), active(true) {
-    }
-};
-
-// Bullet state data
-struct BulletState {
-    uint16_t id;
-    ClientID ownerID;
-    float posX;
-    float posY;
-    float velocityX;
-    float velocityY;
-    bool active;
-
-    BulletState() : id(0), ownerID(0), posX(0), posY(0), velocityX(0), velocityY(0), active(true) {}
-};
-
-// Game state message
-struct GameStateMessage : NetworkMessage {
-    uint8_t playerCount;
-    uint16_t asteroidCount;
-    uint16_t bulletCount;
-    uint8_t gameStatus; // 0 = waiting, 1 = in progress, 2 = game over
-
-    // Variable-length data follows:
-    // ShipState[playerCount] - ship states
-    // AsteroidState[asteroidCount] - asteroid states
-    // BulletState[bulletCount] - bullet states
-
-    GameStateMessage() : NetworkMessage(MessageType::GAME_STATE, 0, 0),
-        playerCount(0), asteroidCount(0), bulletCount(0), gameStatus(0) {
-    }
-};
-
-// Connection accept message
-struct ConnectAcceptMessage : NetworkMessage {
-    ClientID assignedID;
-    uint8_t totalPlayers;
-
-    ConnectAcceptMessage() : NetworkMessage(MessageType::CONNECT_ACCEPT, 0, 0),
-        assignedID(0), totalPlayers(0) {
-    }
-};
-
-// Game end message
-struct GameEndMessage : NetworkMessage {
-    ClientID winnerID;
-    uint32_t winnerScore;
-    uint32_t scores[4]; // Array of scores for all players
-
-    GameEndMessage() : NetworkMessage(MessageType::GAME_END, 0, 0),
-        winnerID(0), winnerScore(0) {
-        for (int i = 0; i < 4; i++) scores[i] = 0;
-    }
+// Server wide rate limit counters
+struct RateLimitStats {
+    uint64_t droppedPackets;
+    uint64_t droppedBytes;
+    uint64_t abuseDisconnects;
 };
-#pragma pack(pop)
 
 // Client connection data for server
 struct ClientConnection {
@@ -156,8 +73,11 @@ struct ClientConnection {
     bool active;
     uint16_t lastReceivedSequence;
     std::chrono::steady_clock::time_point lastHeartbeatTime;
+    ClientRateLimit rateLimit;
+    PacketBuilder outgoing;         // messages queued for the next flush
+    uint16_t outgoingSequence;
 
-    ClientConnection() : id(0), active(false), lastReceivedSequence(0) {}
+    ClientConnection() : id(0), active(false), lastReceivedSequence(0), outgoingSequence(0) {}
 };
 
 // UDPServer class
@@ -177,34 +97,133 @@ public:
     // Broadcast data to all clients
     bool BroadcastToAll(const void* data, size_t size);
 
+    // Queue a message for a client. Queued messages are coalesced into as few datagrams
+    // as fit the MTU and sent by FlushOutgoing, in queue order. Messages too large to
+    // bundle are sent right away, after whatever was queued before them.
+    bool QueueToClient(ClientID clientID, const void* data, size_t size);
+    bool QueueToAll(const void* data, size_t size);
+
+    // Send everything queued, called once per tick
+    void FlushOutgoing();
+
+    // Messages handed to the Queue functions and the datagrams they went out in
+    uint64_t GetQueuedMessageCount() const { return queuedMessages.load(std::memory_order_relaxed); }
+    uint64_t GetFlushedDatagramCount() const { return flushedDatagrams.load(std::memory_order_relaxed); }
+
     // Get connected client count
     size_t GetClientCount() const;
 
     // Check if a client is connected
     bool IsClientConnected(ClientID clientID) const;
 
+    // Maximum number of simultaneously connected clients (default 4, at most 254 since ClientID 0 is the server)
+    void SetMaxClients(size_t count);
+    size_t GetMaxClients() const { return maxClients; }
+
+    // Record every inbound and outbound datagram to a capture file
+    bool StartCapture(const std::string& path);
+    void StopCapture();
+    bool IsCapturing() const { return capture.IsOpen(); }
+
+    // Record a game tick marker so a replay can reproduce the tick cadence
+    void CaptureTick(float dt);
+
+    // Start without a socket or network thread; datagrams are fed in with InjectDatagram
+    bool InitializeReplay();
+
+    // Process a datagram as if it had been received from the given address,
+    // timestampUs microseconds after InitializeReplay (drives heartbeats and rate limits)
+    void InjectDatagram(const void* data, size_t size, const sockaddr_in& fromAddr, uint64_t timestampUs);
+
+    // Time out the clients that went quiet, as the network thread does live, at the
+    // captured time timestampUs microseconds after InitializeReplay
+    void CheckReplayTimeouts(uint64_t timestampUs);
+
+    // Per-connection inbound rate limiting, checked before any message is dispatched.
+    // Connection requests from unknown addresses are not limited.
+    void SetRateLimit(const RateLimitConfig& config);
+    RateLimitConfig GetRateLimit() const;
+    RateLimitStats GetRateLimitStats() const;
+    bool GetClientRateLimit(ClientID clientID, ClientRateLimit& out) const;
+
     // Set callbacks for message handling
     void SetConnectCallback(std::function<void(ClientID)> callback) { onClientConnect = callback; }
     void SetDisconnectCallback(std::function<void(ClientID)> callback) { onClientDisconnect = callback; }
     void SetMessageCallback(std::function<void(ClientID, const void*, size_t)> callback) { onMessage = callback; }
 
+    // Received message and byte counts per message type
+    const MessageTypeStats& GetMessageStats(MessageType type) const { return dispatcher.GetStats(type); }
+
 private:
     void NetworkThread();
-    void CheckClientTimeouts();
     void ProcessIncomingMessages();
-    bool HandleConnectionRequest(const sockaddr_in& clientAddr);
+    typedef std::chrono::steady_clock::time_point TimePoint;
+
+    // now is the current time, or the captured time during replays
+    void CheckClientTimeouts(TimePoint now);
+
+    // now is the receive time, or the captured time during replays
+    void HandleDatagram(const char* buffer, int bytesReceived, const sockaddr_in& clientAddr, TimePoint now);
+    bool HandleConnectionRequest(const sockaddr_in& clientAddr, TimePoint now);
+    void HandleDisconnectRequest(ClientID senderID);
+    void HandleHeartbeat(ClientID senderID, TimePoint now);
+    void ForwardToGame(ClientID senderID, const void* data, size_t size, TimePoint now);
+
+    // Refill the client's token buckets and take one packet of this size (clientsMutex must be held).
+    // Sets abusive when the client should be disconnected.
+    bool AdmitPacket(ClientConnection& client, size_t size, TimePoint now, bool& abusive);
+    void DisconnectAbusiveClient(ClientID clientID);
+
+    // Send a datagram and record it when capturing
+    bool SendRaw(const sockaddr_in& addr, ClientID clientID, const void* data, size_t size);
+
+    // Outgoing packet builder of one client (clientsMutex must be held)
+    bool QueueLocked(ClientConnection& client, const void* data, size_t size);
+    bool FlushLocked(ClientConnection& client);
+
+    // Find the connected client using this address, 0 if none (clientsMutex must be held)
+    ClientID FindClientByAddress(const sockaddr_in& addr) const;
+
+    // Mark a client disconnected and forget its address (clientsMutex must be held)
+    void DeactivateLocked(ClientConnection& client);
+
+    // IPv4 address and port in one integer, the key of clientsByAddress
+    static uint64_t AddressKey(const sockaddr_in& addr) {
+        return (static_cast<uint64_t>(addr.sin_addr.s_addr) << 16) | addr.sin_port;
+    }
+
+    // Pick an unused client ID, 0 if the server is full (clientsMutex must be held)
+    ClientID AllocateClientID();
 
     SOCKET socket;
     std::atomic<bool> isRunning;
+    bool replayMode;
+    TimePoint replayStartTime;
     std::thread networkThread;
 
     mutable std::mutex clientsMutex;
     std::map<ClientID, ClientConnection> clients;
+    std::unordered_map<uint64_t, ClientID> clientsByAddress;   // active clients only, every datagram looks up its sender
     ClientID nextClientID;
+    size_t maxClients;
+
+    RateLimitConfig rateLimit;      // guarded by clientsMutex
+    std::atomic<uint64_t> droppedPackets;
+    std::atomic<uint64_t> droppedBytes;
+    std::atomic<uint64_t> abuseDisconnects;
+
+    std::atomic<uint64_t> queuedMessages;
+    std::atomic<uint64_t> flushedDatagrams;
 
     std::function<void(ClientID)> onClientConnect;
     std::function<void(ClientID)> onClientDisconnect;
     std::function<void(ClientID, const void*, size_t)> onMessage;
+
+    // Connection messages are handled here, everything else goes to onMessage.
+    // Handlers get the sender address, its client ID (0 if not connected) and the receive time.
+    MessageDispatcher<const sockaddr_in&, ClientID, TimePoint> dispatcher;
+
+    PacketCaptureWriter capture;
 };
 
 // UDPClient class
@@ -228,14 +247,27 @@ public:
     // Send data to server
     bool SendToServer(const void* data, size_t size);
 
+    // Queue a message for the server; FlushToServer sends the queue in as few datagrams as possible.
+    // Call FlushToServer once per frame.
+    bool QueueToServer(const void* data, size_t size);
+    bool FlushToServer();
+
     // Set callbacks for message handling
     void SetConnectCallback(std::function<void(ClientID)> callback) { onConnect = callback; }
     void SetDisconnectCallback(std::function<void()> callback) { onDisconnect = callback; }
     void SetMessageCallback(std::function<void(const void*, size_t)> callback) { onMessage = callback; }
 
+    // Received message and byte counts per message type
+    const MessageTypeStats& GetMessageStats(MessageType type) const { return dispatcher.GetStats(type); }
+
 private:
     void NetworkThread();
     void SendHeartbeat();
+    bool SendDatagram(const void* data, size_t size);
+    bool FlushLocked();
+    void HandleConnectAccept(const ConnectAcceptMessage& msg);
+    void HandleConnectReject();
+    void HandleServerDisconnect();
 
     SOCKET socket;
     std::atomic<bool> isRunning;
@@ -246,9 +278,17 @@ private:
     ClientID clientID;
     uint16_t sequenceNumber;
 
+    std::mutex sendMutex;
+    PacketBuilder outgoing;                     // guarded by sendMutex
+    uint16_t outgoingSequence;                  // guarded by sendMutex
+    std::atomic<int64_t> lastSendTicks;         // steady_clock ticks of the last datagram, heartbeats are skipped while traffic flows
+
     std::function<void(ClientID)> onConnect;
     std::function<void()> onDisconnect;
     std::function<void(const void*, size_t)> onMessage;
+
+    // Connection messages are handled here, everything else goes to onMessage
+    MessageDispatcher<> dispatcher;
 };
 
 #endif // UDP_NETWORK_H
\ No newline at end of file
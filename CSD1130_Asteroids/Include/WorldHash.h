@@ -0,0 +1,66 @@
+// WorldHash.h
+// Desync check shared by the game server and anything that rebuilds the world from
+// snapshots. Only depends on the C++ standard library so the tools can use it too.
+#ifndef WORLD_HASH_H
+#define WORLD_HASH_H
+
+#include <cstdint>
+
+// Positions and velocities are hashed on a grid of 1/16 world unit: fine enough to catch
+// any real divergence, coarse enough that a view rebuilt with different float rounding
+// still matches.
+constexpr float WORLD_HASH_STEPS_PER_UNIT = 16.0f;
+
+// What an object is, as far as the hash is concerned
+enum WorldHashKind : uint8_t {
+    WORLD_HASH_SHIP = 0,
+    WORLD_HASH_BULLET = 1,
+    WORLD_HASH_ASTEROID = 2
+};
+
+// Order independent hash of a set of objects.
+// Every object is hashed on its own and the object hashes are summed, so the result does
+// not depend on the order a client stores its objects in, and adding or removing one
+// object is O(1) for a view that keeps a running hash.
+class WorldHash {
+public:
+    WorldHash() : sum(0) {}
+
+    void Reset() { sum = 0; }
+
+    void Add(uint8_t kind, float posX, float posY, float velX, float velY) {
+        sum += Object(kind, posX, posY, velX, velY);
+    }
+
+    void Remove(uint8_t kind, float posX, float posY, float velX, float velY) {
+        sum -= Object(kind, posX, posY, velX, velY);
+    }
+
+    // Never 0, which the messages use for "no hash"
+    uint32_t Value() const { return sum != 0 ? sum : 1u; }
+
+    static uint32_t Object(uint8_t kind, float posX, float posY, float velX, float velY) {
+        uint64_t position = (static_cast<uint64_t>(Quantize(posX)) << 32) | Quantize(posY);
+        uint64_t velocity = (static_cast<uint64_t>(Quantize(velX)) << 32) | Quantize(velY);
+        return static_cast<uint32_t>(Mix(Mix(position) + velocity + kind * 0x9E3779B97F4A7C15ull) >> 32);
+    }
+
+private:
+    // Rounded to the nearest step; floor done by hand, std::floor is a library call on SSE2
+    static uint32_t Quantize(float value) {
+        float scaled = value * WORLD_HASH_STEPS_PER_UNIT + 0.5f;
+        int32_t truncated = static_cast<int32_t>(scaled);
+        return static_cast<uint32_t>(truncated - (scaled < static_cast<float>(truncated) ? 1 : 0));
+    }
+
+    // SplitMix64 finalizer
+    static uint64_t Mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint32_t sum;
+};
+
+#endif // WORLD_HASH_H
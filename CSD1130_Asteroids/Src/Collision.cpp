@@ -14,6 +14,13 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 
 #include "main.h"
 
+// Define COLLISION_NO_SIMD to force the scalar batch test
+#if !defined(COLLISION_NO_SIMD) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define COLLISION_SSE2
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
 /**************************************************************************/
 /*!
 
@@ -25,11 +32,21 @@ bool CollisionIntersection_RectRect(const AABB & aabb1,          //Input
 									const AEVec2 & vel2,         //Input
 									float& firstTimeOfCollision) //Output: the calculated value of tFirst, below, must be returned here
 {
-	UNREFERENCED_PARAMETER(aabb1);
-	UNREFERENCED_PARAMETER(vel1);
-	UNREFERENCED_PARAMETER(aabb2);
-	UNREFERENCED_PARAMETER(vel2);
-	UNREFERENCED_PARAMETER(firstTimeOfCollision);
+	return CollisionIntersection_RectRect(aabb1, vel1, aabb2, vel2, g_dt, firstTimeOfCollision);
+}
+
+/**************************************************************************/
+/*!
+
+	*/
+/**************************************************************************/
+bool CollisionIntersection_RectRect(const AABB & aabb1,          //Input
+									const AEVec2 & vel1,         //Input
+									const AABB & aabb2,          //Input
+									const AEVec2 & vel2,         //Input
+									float dt,                    //Input
+									float& firstTimeOfCollision) //Output: the calculated value of tFirst
+{
 
 	/*
 	Implement the collision intersection over here.
@@ -69,7 +86,7 @@ bool CollisionIntersection_RectRect(const AABB & aabb1,          //Input
 		v_rel.x = vel2.x - vel1.x;
 		v_rel.y = vel2.y - vel1.y;
 		double tFirst = 0.0f;
-		double tLast = g_dt;
+		double tLast = dt;
 
 		// step 3
 		if (v_rel.x < 0) {
@@ -141,6 +158,7 @@ bool CollisionIntersection_RectRect(const AABB & aabb1,          //Input
 		}
 		if (tFirst > tLast)//case 6
 			return 0;
+		firstTimeOfCollision = static_cast<float>(tFirst);
 		return 1;
 	}
 	else {
@@ -148,4 +166,186 @@ bool CollisionIntersection_RectRect(const AABB & aabb1,          //Input
 		return 1;
 	}
 	
-}
\ No newline at end of file
+}
+
+/**************************************************************************/
+/*!
+	The scalar test above, one candidate at a time. Used for the tail of
+	the SIMD loop and when SSE2 is not available.
+	*/
+/**************************************************************************/
+static unsigned int RectRectBatchScalar(const AABB& aabb1, const AEVec2& vel1,
+										const AABB* aabb2, const AEVec2* vel2,
+										unsigned int begin, unsigned int end, float dt,
+										unsigned int* hitIndices, float* hitTimes)
+{
+	unsigned int hits = 0;
+	for (unsigned int i = begin; i < end; ++i) {
+		float t;
+		if (CollisionIntersection_RectRect(aabb1, vel1, aabb2[i], vel2[i], dt, t)) {
+			hitIndices[hits] = i;
+			hitTimes[hits] = t;
+			++hits;
+		}
+	}
+	return hits;
+}
+
+#ifdef COLLISION_SSE2
+/**************************************************************************/
+/*!
+	One axis of the swept test for four candidates. a0/a1 are the min/max
+	of aabb1, b0/b1 the candidates' min/max and v their velocity relative
+	to aabb1. Updates tFirst/tLast and returns the lanes the axis rejects,
+	case by case like the scalar test.
+	*/
+/**************************************************************************/
+static __m128 RectRectAxis4(__m128 a0, __m128 a1, __m128 b0, __m128 b1, __m128 v,
+							__m128& tFirst, __m128& tLast)
+{
+	const __m128 zero = _mm_setzero_ps();
+	__m128 neg = _mm_cmplt_ps(v, zero);
+	__m128 pos = _mm_cmpgt_ps(v, zero);
+	__m128 still = _mm_andnot_ps(_mm_or_ps(neg, pos), _mm_castsi128_ps(_mm_set1_epi32(-1)));
+
+	__m128 before = _mm_cmplt_ps(a1, b0);		// aabb1 entirely below the candidate
+	__m128 after = _mm_cmpgt_ps(a0, b1);		// aabb1 entirely above the candidate
+
+	// cases 1, 3 and 5
+	__m128 reject = _mm_or_ps(_mm_or_ps(_mm_and_ps(neg, after), _mm_and_ps(pos, before)),
+		_mm_and_ps(still, _mm_or_ps(before, after)));
+
+	// Both bounds come from the same two quotients, swapped by the sign of v
+	__m128 d1 = _mm_div_ps(_mm_sub_ps(a1, b0), v);
+	__m128 d0 = _mm_div_ps(_mm_sub_ps(a0, b1), v);
+
+	// cases 4 and 2
+	__m128 firstMask = _mm_or_ps(_mm_and_ps(neg, before), _mm_and_ps(pos, after));
+	__m128 first = _mm_or_ps(_mm_and_ps(neg, d1), _mm_andnot_ps(neg, d0));
+	tFirst = _mm_or_ps(_mm_and_ps(firstMask, _mm_max_ps(first, tFirst)), _mm_andnot_ps(firstMask, tFirst));
+
+	__m128 lastMask = _mm_or_ps(_mm_and_ps(neg, _mm_cmplt_ps(a0, b1)), _mm_and_ps(pos, _mm_cmpgt_ps(a1, b0)));
+	__m128 last = _mm_or_ps(_mm_and_ps(neg, d0), _mm_andnot_ps(neg, d1));
+	tLast = _mm_or_ps(_mm_and_ps(lastMask, _mm_min_ps(last, tLast)), _mm_andnot_ps(lastMask, tLast));
+
+	return reject;
+}
+#endif
+
+/**************************************************************************/
+/*!
+
+	*/
+/**************************************************************************/
+unsigned int CollisionIntersection_RectRectBatch(const AABB& aabb1,            //Input
+												 const AEVec2& vel1,           //Input
+												 const AABB* aabb2,            //Input: count candidates
+												 const AEVec2* vel2,           //Input: count candidate velocities
+												 unsigned int count,           //Input
+												 float dt,                     //Input: the time step
+												 unsigned int* hitIndices,     //Output
+												 float* hitTimes)              //Output
+{
+	unsigned int hits = 0;
+	unsigned int i = 0;
+
+#ifdef COLLISION_SSE2
+	// Four candidates per iteration, boxes and velocities transposed to one axis per register
+	const __m128 a0x = _mm_set1_ps(aabb1.min.x), a0y = _mm_set1_ps(aabb1.min.y);
+	const __m128 a1x = _mm_set1_ps(aabb1.max.x), a1y = _mm_set1_ps(aabb1.max.y);
+	const __m128 v1x = _mm_set1_ps(vel1.x), v1y = _mm_set1_ps(vel1.y);
+	const __m128 dtv = _mm_set1_ps(dt);
+	const float* boxes = reinterpret_cast<const float*>(aabb2);
+	const float* vels = reinterpret_cast<const float*>(vel2);
+
+	for (; i + 4 <= count; i += 4) {
+		__m128 b0x = _mm_loadu_ps(boxes + 4 * i);
+		__m128 b0y = _mm_loadu_ps(boxes + 4 * i + 4);
+		__m128 b1x = _mm_loadu_ps(boxes + 4 * i + 8);
+		__m128 b1y = _mm_loadu_ps(boxes + 4 * i + 12);
+		_MM_TRANSPOSE4_PS(b0x, b0y, b1x, b1y);
+
+		__m128 v01 = _mm_loadu_ps(vels + 2 * i);
+		__m128 v23 = _mm_loadu_ps(vels + 2 * i + 4);
+		__m128 vx = _mm_sub_ps(_mm_shuffle_ps(v01, v23, _MM_SHUFFLE(2, 0, 2, 0)), v1x);
+		__m128 vy = _mm_sub_ps(_mm_shuffle_ps(v01, v23, _MM_SHUFFLE(3, 1, 3, 1)), v1y);
+
+		// step 1: already overlapping
+		__m128 apart = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(a1x, b0x), _mm_cmplt_ps(a1y, b0y)),
+			_mm_or_ps(_mm_cmpgt_ps(a0x, b1x), _mm_cmpgt_ps(a0y, b1y)));
+
+		// steps 2 to 4, case 6 once at the end since tFirst only grows and tLast only shrinks
+		__m128 tFirst = _mm_setzero_ps();
+		__m128 tLast = dtv;
+		__m128 reject = RectRectAxis4(a0x, a1x, b0x, b1x, vx, tFirst, tLast);
+		reject = _mm_or_ps(reject, RectRectAxis4(a0y, a1y, b0y, b1y, vy, tFirst, tLast));
+		reject = _mm_or_ps(reject, _mm_cmpgt_ps(tFirst, tLast));
+
+		// Overlapping, or apart and not rejected
+		int mask = ~_mm_movemask_ps(_mm_and_ps(apart, reject)) & 0xF;
+		if (mask == 0)
+			continue;
+
+		float times[4];
+		_mm_storeu_ps(times, _mm_and_ps(apart, tFirst));
+		for (unsigned int lane = 0; lane < 4; ++lane) {
+			if (mask & (1 << lane)) {
+				hitIndices[hits] = i + lane;
+				hitTimes[hits] = times[lane];
+				++hits;
+			}
+		}
+	}
+#endif
+
+	return hits + RectRectBatchScalar(aabb1, vel1, aabb2, vel2, i, count, dt, hitIndices + hits, hitTimes + hits);
+}
+
+/**************************************************************************/
+/*!
+
+	*/
+/**************************************************************************/
+bool CollisionIntersection_CircleCircle(const AEVec2& center1,        //Input
+										float radius1,                //Input
+										const AEVec2& vel1,           //Input
+										const AEVec2& center2,        //Input
+										float radius2,                //Input
+										const AEVec2& vel2,           //Input
+										float dt,                     //Input: the time step
+										float& firstTimeOfCollision)  //Output
+{
+	// static: squared distance against the squared sum of the radii
+	float dx = center2.x - center1.x;
+	float dy = center2.y - center1.y;
+	float radiusSum = radius1 + radius2;
+	if (dx * dx + dy * dy <= radiusSum * radiusSum) {
+		firstTimeOfCollision = 0.0f;
+		return 1;
+	}
+
+	// dynamic: circle 1 moves by the relative velocity, circle 2 stands still
+	AEVec2 start = center1, end{}, center = center2, inter{};
+	float moveX = (vel1.x - vel2.x) * dt;
+	float moveY = (vel1.y - vel2.y) * dt;
+	float moveSq = moveX * moveX + moveY * moveY;
+	if (moveSq == 0.0f)
+		return 0;
+
+	// out of reach: farther apart than the radii plus the distance moved,
+	// compared squared as d^2 > s^2 + m^2 + 2sm <=> (d^2 - s^2 - m^2)^2 > 4 s^2 m^2
+	float gap = dx * dx + dy * dy - radiusSum * radiusSum - moveSq;
+	if (gap > 0.0f && gap * gap > 4.0f * radiusSum * radiusSum * moveSq)
+		return 0;
+
+	end.x = center1.x + moveX;
+	end.y = center1.y + moveY;
+
+	// time along the path from start (0) to end (1), -1 for a miss
+	float t = AEAnimatedCircleToStaticCircle(&start, &end, radius1, &center, radius2, &inter);
+	if (t < 0.0f || t > 1.0f)
+		return 0;
+
+	firstTimeOfCollision = t * dt;
+	return 1;
+}
@@ -0,0 +1,247 @@
+// EntityStore.cpp
+#include "EntityStore.h"
+
+// Define ENTITY_STORE_NO_SIMD to force the scalar paths
+#if !defined(ENTITY_STORE_NO_SIMD) && !defined(SIM_FIXED_POINT) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define ENTITY_STORE_SSE2
+#include <emmintrin.h>
+#endif
+
+EntityStore::EntityStore(uint32_t capacity) : capacity(capacity) {
+    // Reserved once, creating entities never reallocates
+    type.reserve(capacity);
+    active.reserve(capacity);
+    posCurr.reserve(capacity);
+    posPrev.reserve(capacity);
+    velCurr.reserve(capacity);
+    scale.reserve(capacity);
+    dirCurr.reserve(capacity);
+    boundingBox.reserve(capacity);
+    cold.reserve(capacity);
+    ids.reserve(capacity);
+    destroyedIndices.reserve(capacity);
+
+    sparse.assign(capacity, 0u);
+    generation.assign(capacity, 1u);
+    freeSlots.reserve(capacity);
+
+    Clear();
+}
+
+void EntityStore::Clear() {
+    // Handles from before the clear must not match the new entities
+    for (uint32_t i = 0; i < Count(); i++) {
+        uint32_t slot = ids[i] & SLOT_MASK;
+        if (active[i]) {
+            generation[slot] = NextGeneration(generation[slot]);
+        }
+    }
+
+    type.clear();
+    active.clear();
+    posCurr.clear();
+    posPrev.clear();
+    velCurr.clear();
+    scale.clear();
+    dirCurr.clear();
+    boundingBox.clear();
+    cold.clear();
+    ids.clear();
+    destroyedIndices.clear();
+
+    // Slots handed out from 0 up
+    freeSlots.clear();
+    for (uint32_t i = 0; i < capacity; i++) {
+        freeSlots.push_back(capacity - 1 - i);
+    }
+}
+
+EntityID EntityStore::Create(uint8_t entityType, const AEVec2& entityScale, const SimVec2& pos, const SimVec2& vel,
+    SimScalar dir) {
+    if (freeSlots.empty()) {
+        return INVALID_ENTITY;
+    }
+
+    uint32_t slot = freeSlots.back();
+    freeSlots.pop_back();
+
+    uint32_t index = Count();
+    EntityID id = (static_cast<EntityID>(generation[slot]) << SLOT_BITS) | slot;
+    sparse[slot] = index;
+    ids.push_back(id);
+
+    type.push_back(entityType);
+    active.push_back(1);
+    posCurr.push_back(pos);
+    posPrev.push_back(pos);
+    velCurr.push_back(vel);
+    scale.push_back(entityScale);
+    dirCurr.push_back(dir);
+    boundingBox.push_back(AABB());
+    cold.push_back(EntityCold());
+    AEMtx33Identity(&cold.back().transform);
+    cold.back().owner = 0;
+
+    // Valid bounding box before the first update, the collision pass may see it this tick
+    UpdateBounds(index);
+    return id;
+}
+
+void EntityStore::Destroy(EntityID id) {
+#ifdef _DEBUG
+    // Destroying a dead entity means a stale handle is still around
+    AE_ASSERT_MESG(IsAlive(id), "EntityStore::Destroy: entity %08x destroyed twice", id);
+#endif
+
+    if (!IsAlive(id)) {
+        return;
+    }
+
+    // The handle goes stale now, the slot is reused after the flush
+    uint32_t slot = id & SLOT_MASK;
+    active[sparse[slot]] = 0;
+    generation[slot] = NextGeneration(generation[slot]);
+    destroyedIndices.push_back(sparse[slot]);
+}
+
+bool EntityStore::IsAlive(EntityID id) const {
+    uint32_t slot = id & SLOT_MASK;
+    if (id == INVALID_ENTITY || slot >= capacity || generation[slot] != (id >> SLOT_BITS)) {
+        return false;
+    }
+    uint32_t index = sparse[slot];
+    return index < Count() && ids[index] == id && active[index] != 0;
+}
+
+void EntityStore::FlushDestroyed() {
+    // Swap and pop: the last entity moves into the hole, nothing else shifts. Destroyed
+    // entities at the end are popped first, so the one that moves is always alive.
+    for (uint32_t hole : destroyedIndices) {
+        while (Count() > 0 && !active[Count() - 1]) {
+            freeSlots.push_back(ids.back() & SLOT_MASK);
+            PopBack();
+        }
+
+        // Popped above, or filled by an earlier move
+        if (hole >= Count() || active[hole]) {
+            continue;
+        }
+
+        freeSlots.push_back(ids[hole] & SLOT_MASK);
+        MoveEntity(Count() - 1, hole);
+        PopBack();
+    }
+    destroyedIndices.clear();
+}
+
+void EntityStore::MoveEntity(uint32_t from, uint32_t to) {
+    ids[to] = ids[from];
+    type[to] = type[from];
+    active[to] = active[from];
+    posCurr[to] = posCurr[from];
+    posPrev[to] = posPrev[from];
+    velCurr[to] = velCurr[from];
+    scale[to] = scale[from];
+    dirCurr[to] = dirCurr[from];
+    boundingBox[to] = boundingBox[from];
+    cold[to] = cold[from];
+    sparse[ids[to] & SLOT_MASK] = to;
+}
+
+void EntityStore::PopBack() {
+    ids.pop_back();
+    type.pop_back();
+    active.pop_back();
+    posCurr.pop_back();
+    posPrev.pop_back();
+    velCurr.pop_back();
+    scale.pop_back();
+    dirCurr.pop_back();
+    boundingBox.pop_back();
+    cold.pop_back();
+}
+
+const AEMtx33& EntityStore::BuildTransform(uint32_t index) {
+    AEMtx33 scaleMtx, rot, trans, temp;
+    AEMtx33Scale(&scaleMtx, scale[index].x, scale[index].y);
+    AEMtx33Rot(&rot, SimToFloat(dirCurr[index]));
+    AEMtx33Trans(&trans, SimToFloat(posCurr[index].x), SimToFloat(posCurr[index].y));
+
+    AEMtx33Concat(&temp, &rot, &scaleMtx);
+    AEMtx33Concat(&cold[index].transform, &trans, &temp);
+    return cold[index].transform;
+}
+
+void EntityStore::Integrate(float dt, const AABB& world, uint32_t wrapTypes) {
+    const uint32_t count = Count();
+    uint32_t i = 0;
+
+#ifdef ENTITY_STORE_SSE2
+    // Two entities per register: AEVec2 arrays are read as x0 y0 x1 y1.
+    // Entities destroyed this tick are advanced as well, the flush drops them anyway.
+    const __m128 dtv = _mm_set1_ps(dt);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 minv = _mm_setr_ps(world.min.x, world.min.y, world.min.x, world.min.y);
+    const __m128 maxv = _mm_setr_ps(world.max.x, world.max.y, world.max.x, world.max.y);
+    const __m128 range = _mm_sub_ps(maxv, minv);
+
+    float* pos = reinterpret_cast<float*>(posCurr.data());
+    float* prev = reinterpret_cast<float*>(posPrev.data());
+    const float* vel = reinterpret_cast<const float*>(velCurr.data());
+    const float* scl = reinterpret_cast<const float*>(scale.data());
+    float* box = reinterpret_cast<float*>(boundingBox.data());
+
+    for (; i + 2 <= count; i += 2) {
+        __m128 p = _mm_loadu_ps(pos + 2 * i);
+        _mm_storeu_ps(prev + 2 * i, p);
+        p = _mm_add_ps(p, _mm_mul_ps(_mm_loadu_ps(vel + 2 * i), dtv));
+
+        // Selected with masks instead of adding zero, which would turn -0 into +0
+        int wrap0 = -static_cast<int>((wrapTypes >> type[i]) & 1u);
+        int wrap1 = -static_cast<int>((wrapTypes >> type[i + 1]) & 1u);
+        __m128 wraps = _mm_castsi128_ps(_mm_setr_epi32(wrap0, wrap0, wrap1, wrap1));
+        __m128 below = _mm_and_ps(_mm_cmplt_ps(p, minv), wraps);
+        __m128 above = _mm_and_ps(_mm_cmpgt_ps(p, maxv), wraps);
+        __m128 wrapped = _mm_or_ps(_mm_and_ps(below, _mm_add_ps(p, range)), _mm_and_ps(above, _mm_sub_ps(p, range)));
+        p = _mm_or_ps(wrapped, _mm_andnot_ps(_mm_or_ps(below, above), p));
+        _mm_storeu_ps(pos + 2 * i, p);
+
+        // AABB is min.x min.y max.x max.y, one entity per register half
+        __m128 h = _mm_mul_ps(_mm_loadu_ps(scl + 2 * i), half);
+        __m128 mn = _mm_sub_ps(p, h);
+        __m128 mx = _mm_add_ps(p, h);
+        _mm_storeu_ps(box + 4 * i, _mm_movelh_ps(mn, mx));
+        _mm_storeu_ps(box + 4 * i + 4, _mm_movehl_ps(mx, mn));
+    }
+#endif
+
+    IntegrateScalar(i, count, dt, world, wrapTypes);
+}
+
+void EntityStore::IntegrateScalar(uint32_t begin, uint32_t end, float dt, const AABB& world, uint32_t wrapTypes) {
+    const SimScalar step = SimFromFloat(dt);
+    const SimScalar minX = SimFromFloat(world.min.x);
+    const SimScalar minY = SimFromFloat(world.min.y);
+    const SimScalar maxX = SimFromFloat(world.max.x);
+    const SimScalar maxY = SimFromFloat(world.max.y);
+    const SimScalar rangeX = maxX - minX;
+    const SimScalar rangeY = maxY - minY;
+
+    for (uint32_t i = begin; i < end; i++) {
+        posPrev[i] = posCurr[i];
+
+        SimScalar x = posCurr[i].x + velCurr[i].x * step;
+        SimScalar y = posCurr[i].y + velCurr[i].y * step;
+
+        if ((wrapTypes >> type[i]) & 1u) {
+            if (x < minX) x = x + rangeX;
+            else if (x > maxX) x = x - rangeX;
+            if (y < minY) y = y + rangeY;
+            else if (y > maxY) y = y - rangeY;
+        }
+
+        posCurr[i].x = x;
+        posCurr[i].y = y;
+        UpdateBounds(i);
+    }
+}
@@ -0,0 +1,213 @@
+// FixedPoint.cpp
+#include "FixedPoint.h"
+#include <algorithm>
+
+// Integer square root, rounded down
+static uint64_t SquareRoot(uint64_t value) {
+    uint64_t result = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > value) {
+        bit >>= 2;
+    }
+
+    while (bit != 0) {
+        if (value >= result + bit) {
+            value -= result + bit;
+            result = (result >> 1) + bit;
+        }
+        else {
+            result >>= 1;
+        }
+        bit >>= 2;
+    }
+    return result;
+}
+
+Fixed FixedSin(Fixed angle) {
+    // Into [-pi, pi), then folded into [-pi/2, pi/2] where the series converges fast
+    int32_t x = angle.Raw() % FIXED_TWO_PI.Raw();
+    if (x >= FIXED_PI.Raw()) {
+        x -= FIXED_TWO_PI.Raw();
+    }
+    else if (x < -FIXED_PI.Raw()) {
+        x += FIXED_TWO_PI.Raw();
+    }
+
+    if (x > FIXED_HALF_PI.Raw()) {
+        x = FIXED_PI.Raw() - x;
+    }
+    else if (x < -FIXED_HALF_PI.Raw()) {
+        x = -FIXED_PI.Raw() - x;
+    }
+
+    // Taylor series to x^11 in 2.30, Horner form:
+    //   x (1 - x^2/6 (1 - x^2/20 (1 - x^2/42 (1 - x^2/72 (1 - x^2/110)))))
+    // Every product stays below 2^62.
+    const int64_t one = 1ll << 30;
+    int64_t x30 = static_cast<int64_t>(x) << (30 - Fixed::FRACTION_BITS);
+    int64_t x2 = (x30 * x30) >> 30;
+
+    int64_t term = one - x2 / 110;
+    term = one - ((x2 * term) >> 30) / 72;
+    term = one - ((x2 * term) >> 30) / 42;
+    term = one - ((x2 * term) >> 30) / 20;
+    term = one - ((x2 * term) >> 30) / 6;
+
+    int64_t result = (x30 * term) >> 30;
+    const int shift = 30 - Fixed::FRACTION_BITS;
+    return Fixed::FromRaw(static_cast<int32_t>((result + (1ll << (shift - 1))) >> shift));
+}
+
+Fixed FixedCos(Fixed angle) {
+    return FixedSin(angle + FIXED_HALF_PI);
+}
+
+Fixed FixedSqrt(Fixed value) {
+    if (value.Raw() <= 0) {
+        return Fixed();
+    }
+    return Fixed::FromRaw(static_cast<int32_t>(SquareRoot(static_cast<uint64_t>(value.Raw()) << Fixed::FRACTION_BITS)));
+}
+
+Fixed FixedLength(Fixed x, Fixed y) {
+    int64_t rawX = x.Raw();
+    int64_t rawY = y.Raw();
+    return Fixed::FromRaw(static_cast<int32_t>(SquareRoot(static_cast<uint64_t>(rawX * rawX) +
+        static_cast<uint64_t>(rawY * rawY))));
+}
+
+Fixed FixedWrap(Fixed x, Fixed low, Fixed high) {
+    if (x < low) {
+        return x + (high - low);
+    }
+    if (x > high) {
+        return x - (high - low);
+    }
+    return x;
+}
+
+// Quotient of two 16.16 values, saturated: a time far past dt is as good as any other
+static Fixed DivideTime(Fixed numerator, Fixed denominator) {
+    int64_t quotient = (static_cast<int64_t>(numerator.Raw()) * Fixed::ONE) / denominator.Raw();
+    quotient = (std::min)(quotient, static_cast<int64_t>(INT32_MAX));
+    quotient = (std::max)(quotient, static_cast<int64_t>(INT32_MIN));
+    return Fixed::FromRaw(static_cast<int32_t>(quotient));
+}
+
+// One axis of the swept box test, case by case like CollisionIntersection_RectRect.
+// vel is box 2 relative to box 1. Returns false when the axis rules the contact out.
+static bool RectRectAxis(Fixed min1, Fixed max1, Fixed min2, Fixed max2, Fixed vel, Fixed& first, Fixed& last) {
+    const Fixed zero;
+    if (vel < zero) {
+        if (min1 > max2) { // case 1
+            return false;
+        }
+        if (max1 < min2) { // case 4
+            first = (std::max)(DivideTime(max1 - min2, vel), first);
+        }
+        if (min1 < max2) {
+            last = (std::min)(DivideTime(min1 - max2, vel), last);
+        }
+    }
+    else if (vel > zero) {
+        if (min1 > max2) { // case 2
+            first = (std::max)(DivideTime(min1 - max2, vel), first);
+        }
+        if (max1 > min2) {
+            last = (std::min)(DivideTime(max1 - min2, vel), last);
+        }
+        if (max1 < min2) { // case 3
+            return false;
+        }
+    }
+    else if (max1 < min2 || min1 > max2) { // case 5
+        return false;
+    }
+
+    // case 6
+    return first <= last;
+}
+
+bool FixedCollision_RectRect(const FixedVec2& min1, const FixedVec2& max1, const FixedVec2& vel1,
+    const FixedVec2& min2, const FixedVec2& max2, const FixedVec2& vel2, Fixed dt, Fixed& time) {
+    // Already overlapping
+    if (!(max1.x < min2.x || max1.y < min2.y || min1.x > max2.x || min1.y > max2.y)) {
+        time = Fixed();
+        return true;
+    }
+
+    Fixed first;
+    Fixed last = dt;
+    if (!RectRectAxis(min1.x, max1.x, min2.x, max2.x, vel2.x - vel1.x, first, last) ||
+        !RectRectAxis(min1.y, max1.y, min2.y, max2.y, vel2.y - vel1.y, first, last)) {
+        return false;
+    }
+
+    time = first;
+    return true;
+}
+
+bool FixedCollision_CircleCircle(const FixedVec2& center1, Fixed radius1, const FixedVec2& vel1,
+    const FixedVec2& center2, Fixed radius2, const FixedVec2& vel2, Fixed dt, Fixed& time) {
+    // static: squared distance against the squared sum of the radii, in 32.32
+    int64_t dx = static_cast<int64_t>(center2.x.Raw()) - center1.x.Raw();
+    int64_t dy = static_cast<int64_t>(center2.y.Raw()) - center1.y.Raw();
+    int64_t radiusSum = static_cast<int64_t>(radius1.Raw()) + radius2.Raw();
+    int64_t distanceSq = dx * dx + dy * dy;
+    if (distanceSq <= radiusSum * radiusSum) {
+        time = Fixed();
+        return true;
+    }
+
+    // dynamic: circle 1 moves by the relative velocity, circle 2 stands still
+    Fixed moveX = (vel1.x - vel2.x) * dt;
+    Fixed moveY = (vel1.y - vel2.y) * dt;
+    if (moveX.Raw() == 0 && moveY.Raw() == 0) {
+        return false;
+    }
+
+    // out of reach: farther apart than the radii plus the distance moved
+    int64_t reach = radiusSum + FixedLength(moveX, moveY).Raw();
+    if (distanceSq > reach * reach) {
+        return false;
+    }
+
+    // Everything left is shorter than reach. Low bits are dropped until reach fits in 15
+    // bits, so the terms of the quadratic below stay within 64 bits.
+    int shift = 0;
+    while ((reach >> shift) >= (1 << 15)) {
+        shift++;
+    }
+    dx >>= shift;
+    dy >>= shift;
+    radiusSum >>= shift;
+    int64_t mx = moveX.Raw() >> shift;
+    int64_t my = moveY.Raw() >> shift;
+
+    // |d - m s| = r for s along the path: (m.m) s^2 - 2 (d.m) s + (d.d - r^2) = 0
+    int64_t a = mx * mx + my * my;
+    int64_t b = dx * mx + dy * my;
+    int64_t c = dx * dx + dy * dy - radiusSum * radiusSum;
+    if (c <= 0) {
+        // Touching once the dropped bits are gone
+        time = Fixed();
+        return true;
+    }
+    if (a == 0 || b <= 0) {
+        return false;
+    }
+
+    int64_t discriminant = b * b - a * c;
+    if (discriminant < 0) {
+        return false;
+    }
+
+    // First root, in 16.16 of the path
+    int64_t along = ((b - static_cast<int64_t>(SquareRoot(static_cast<uint64_t>(discriminant)))) << Fixed::FRACTION_BITS) / a;
+    if (along > Fixed::ONE) {
+        return false;
+    }
+
+    time = Fixed::FromRaw(static_cast<int32_t>(along)) * dt;
+    return true;
+}
@@ -1,15 +1,17 @@
 // GameServer.cpp
 #include "GameServer.h"
 #include <algorithm>
+#include <bitset>
+#include <cstring>
 #include <random>
 #include <iostream>
+#include <chrono>
 
 /******************************************************************************/
 /*!
     Defines
 */
 /******************************************************************************/
-const unsigned int	GAME_OBJ_NUM_MAX = 32;			// The total number of different objects (Shapes)
 const unsigned int	GAME_OBJ_INST_NUM_MAX = 2048;			// The total number of different game object instances
 
 
@@ -32,12 +34,6 @@ const float			SHIP_ROT_SPEED = (2.0f * PI);	// ship rotation speed (degree/secon
 
 const float			BULLET_SPEED = 400.0f;		// bullet speed (m/s)
 
-const float         BOUNDING_RECT_SIZE = 1.0f;         // this is the normalized bounding rectangle (width and height) sizes - AABB collision data
-
-// Additional texture and font
-s8 pFont;
-AEGfxTexture* pTex, * pTex1, * pTexship;
-AEGfxVertexList* pMesh = 0;
 // -----------------------------------------------------------------------------
 enum TYPE
 {
@@ -50,94 +46,334 @@ enum TYPE
     TYPE_NUM
 };
 
-// -----------------------------------------------------------------------------
-// object flag definition
+// Collision shape per type, ships and asteroids are round
+static const COLLIDER_SHAPE TYPE_COLLIDER[TYPE_NUM] = {
+    COLLIDER_CIRCLE,    // TYPE_SHIP
+    COLLIDER_RECT,      // TYPE_BULLET
+    COLLIDER_CIRCLE,    // TYPE_ASTEROID
+    COLLIDER_RECT,      // TYPE_WALL
+};
 
-const unsigned long FLAG_ACTIVE = 0x00000001;
-static bool onValueChange = true;
-static bool over = false;
-/******************************************************************************/
-/*!
-    Struct/Class Definitions
-*/
-/******************************************************************************/
+static AABB WorldBounds() {
+    AABB world;
+    AEVec2Set(&world.min, WORLD_MIN_X, WORLD_MIN_Y);
+    AEVec2Set(&world.max, WORLD_MAX_X, WORLD_MAX_Y);
+    return world;
+}
 
-//Game object structure
-struct GameObj
-{
-    unsigned long		type;		// object type
-    AEGfxVertexList* pMesh;		// This will hold the triangles which will form the shape of the object
-};
+GameServer::GameServer()
+    : isRunning(false),
+    gameInProgress(false),
+    tickAccumulator(0.0f),
+    currentTick(0),
+    skippedTicks(0),
+    gameEndTimer(0.0f),
+    snapshotSequence(0),
+    randomSeed(0),
+    matchCount(0),
+    matchLogHashes(false),
+    worldHashes(false),
+    sentWorldHashes(),
+    worldHashMismatches(0),
+    entities(GAME_OBJ_INST_NUM_MAX),
+    rollbackWindow(0),
+    rollbackTick(NO_ROLLBACK),
+    rollbackFloor(0),
+    resimulating(false),
+    announcedEndMatch(0),
+    sentGameEnds(0),
+    eventReplication(false),
+    objectSnapshotPending(false),
+    objectEventSequence(0),
+    asteroidGrid(ASTEROID_MAX_SCALE_X) {
+    asteroidGrid.SetWorld(WorldBounds());
+
+    // Every ClientID fits without reallocating, saved states copy into the same capacity
+    players.reserve(UINT8_MAX + 1);
+    asteroids.reserve(GAME_OBJ_INST_NUM_MAX);
+
+    // Different matches on every run unless SetRandomSeed fixes the seed
+    std::random_device rd;
+    randomSeed = (static_cast<uint64_t>(rd()) << 32) | rd();
 
-// ---------------------------------------------------------------------------
+    messageHandlers.Register<MessageType::PLAYER_INPUT>(
+        [this](ClientID clientID, const MessageView<PlayerInputMessage>& msg) {
+            ProcessPlayerInput(clientID, &msg.Get());
+        });
+}
 
-//Game object instance structure
-struct GameObjInst
-{
-    GameObj* pObject;	// pointer to the 'original' shape
-    unsigned long		flag;		// bit flag or-ed together
-    AEVec2				scale;		// scaling value of the object instance
-    AEVec2				posCurr;	// object current position
-
-    AEVec2				posPrev;	// object previous position -> it's the position calculated in the previous loop
-
-    AEVec2				velCurr;	// object current velocity
-    float				dirCurr;	// object current direction
-    AABB				boundingBox;// object bouding box that encapsulates the object
-    AEMtx33				transform;	// object transformation matrix: Each frame, 
-    // calculate the object instance's transformation matrix and save it here
-
-// Add these new properties for multiplayer
-    uint16_t            id;         // for identifying asteroids and bullets
-    uint8_t             clientID;   // for identifying which player owns the object
-    float               lifeTime;   // for bullets lifetime tracking
-};
+GameServer::~GameServer() {
+    Shutdown();
+}
 
-/******************************************************************************/
-/*!
-    Static Variables
-*/
-/******************************************************************************/
+void GameServer::SetWorldHashes(bool enable) {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    worldHashes = enable;
+    for (SentWorldHash& sent : sentWorldHashes) {
+        sent.hash = 0;
+    }
+}
 
-// list of original object
-static GameObj				sGameObjList[GAME_OBJ_NUM_MAX];				// Each element in this array represents a unique game object (shape)
-static unsigned long		sGameObjNum;								// The number of defined game objects
+void GameServer::SetEventReplication(bool enable) {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    eventReplication = enable;
+    // Nothing is known to the clients until the next snapshot with the objects
+    replicatedObjects.assign(enable ? GAME_OBJ_INST_NUM_MAX : 0, INVALID_ENTITY);
+    objectSnapshotPending = true;
+
+    // The objects already there go out with the first events
+    spawnedObjects.clear();
+    destroyedObjects.clear();
+    if (enable) {
+        std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+        spawnedObjects.assign(asteroids.begin(), asteroids.end());
+        for (auto& pair : players) {
+            for (unsigned int i = 0; i < pair.second.bullets.size(); i++) {
+                spawnedObjects.push_back(pair.second.bullets[i].id);
+            }
+        }
+    }
+}
 
-// list of object instances
-static GameObjInst			sGameObjInstList[GAME_OBJ_INST_NUM_MAX];	// Each element in this array represents a unique game object instance (sprite)
-static unsigned long		sGameObjInstNum;							// The number of used game object instances
+void GameServer::LogObjectSpawn(EntityID id) {
+    // A re-simulation is compared as a whole afterwards
+    if (eventReplication && !resimulating) {
+        spawnedObjects.push_back(id);
+    }
+}
 
-// pointer to the ship object
-static GameObjInst* spShip;										// Pointer to the "Ship" game object instance
+void GameServer::DestroyObject(EntityID id) {
+    entities.Destroy(id);
+    if (eventReplication && !resimulating) {
+        destroyedObjects.push_back(id);
+    }
+}
+
+GameServer::SavedWorldState::SavedWorldState(uint32_t capacity)
+    : tick(0), valid(false), gameInProgress(false), gameEndTimer(0.0f), matchCount(0), entities(capacity) {
+    players.reserve(UINT8_MAX + 1);
+    asteroids.reserve(capacity);
+}
+
+void GameServer::SetSavedStateCount(unsigned int ticks) {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
 
-// pointer to the wall object
-static GameObjInst* spWall;										// Pointer to the "Wall" game object instance
+    savedStates.clear();
+    savedStates.reserve(ticks);
+    for (unsigned int i = 0; i < ticks; i++) {
+        savedStates.emplace_back(GAME_OBJ_INST_NUM_MAX);
+    }
+}
 
-// number of ship available (lives 0 = game over)
-static long					sShipLives;									// The number of lives left
+void GameServer::SaveWorldState() {
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    // Vectors assigned into reserved ones copy their elements in place, nothing is allocated
+    SavedWorldState& state = savedStates[currentTick % savedStates.size()];
+    state.tick = currentTick;
+    state.valid = true;
+    state.gameInProgress = gameInProgress;
+    state.gameEndTimer = gameEndTimer;
+    state.matchCount = matchCount;
+    state.random = random;
+    state.players = players;
+    state.entities = entities;
+    state.asteroids = asteroids;
+}
 
-// the score = number of asteroid destroyed
-static unsigned long		sScore;										// Current score
+bool GameServer::RestoreWorldState(uint32_t tick) {
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
 
-// ---------------------------------------------------------------------------
+    if (savedStates.empty()) {
+        return false;
+    }
 
-// functions to create/destroy a game object instance
-GameObjInst* gameObjInstCreate(unsigned long type, AEVec2* scale,
-    AEVec2* pPos, AEVec2* pVel, float dir);
-void				gameObjInstDestroy(GameObjInst* pInst);
+    const SavedWorldState& state = savedStates[tick % savedStates.size()];
+    if (!state.valid || state.tick != tick) {
+        return false;
+    }
 
-GameServer::GameServer()
-    : isRunning(false),
-    gameInProgress(false),
-    gameStateTimer(0.0f),
-    gameEndTimer(0.0f) {
+    currentTick = state.tick;
+    gameInProgress = state.gameInProgress;
+    gameEndTimer = state.gameEndTimer;
+    matchCount = state.matchCount;
+    random = state.random;
+    players = state.players;
+    entities = state.entities;
+    asteroids = state.asteroids;
+    return true;
 }
 
-GameServer::~GameServer() {
-    Shutdown();
+bool GameServer::SetRollbackWindow(unsigned int window) {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+
+    if (window > 0 && matchLog.IsOpen()) {
+        std::cerr << "Rollback mode cannot be used while a match log is recording" << std::endl;
+        return false;
+    }
+
+    // Every tick a late input may rewind to must still be saved
+    if (window > savedStates.size()) {
+        SetSavedStateCount(window);
+    }
+
+    rollbackWindow = window;
+    tickInputs.assign(window > 0 ? (UINT8_MAX + 1) * 2 * window : 0, TickInput());
+    relayedInputs.clear();
+    rollbackTick = NO_ROLLBACK;
+    rollbackFloor = currentTick;
+    return true;
+}
+
+RollbackStats GameServer::GetRollbackStats() {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    return rollbackStats;
 }
 
-bool GameServer::Initialize(uint16_t port) {
+void GameServer::StampInput(ClientID clientID, uint32_t tick, uint8_t buttons) {
+    rollbackStats.stampedInputs++;
+
+    // Past what can be rewound: applied from the next tick, as without rollback
+    if (tick < rollbackFloor || tick + rollbackWindow < currentTick) {
+        rollbackStats.tooLateInputs++;
+        tick = currentTick;
+    }
+    // Too far ahead to hold, the client's clock is off
+    else if (tick >= currentTick + rollbackWindow) {
+        return;
+    }
+
+    const uint32_t ring = 2 * rollbackWindow;
+    TickInput& input = tickInputs[clientID * ring + tick % ring];
+    if (input.tick != tick) {
+        input.tick = tick;
+        input.used = false;
+    }
+    input.buttons = buttons;
+    input.confirmed = true;
+
+    // Already simulated with other buttons. Later ticks of the player repeated those
+    // buttons too, simulating again from this tick fixes all of them.
+    if (tick < currentTick) {
+        rollbackStats.lateInputs++;
+        if (input.used && input.usedButtons != buttons) {
+            rollbackStats.mispredictions++;
+            rollbackTick = (std::min)(rollbackTick, tick);
+        }
+    }
+
+    InputFrameEntry entry;
+    entry.clientID = clientID;
+    entry.tick = tick;
+    entry.buttons = buttons;
+    relayedInputs.push_back(entry);
+}
+
+void GameServer::ApplyTickInputs() {
+    const uint32_t ring = 2 * rollbackWindow;
+    for (auto& pair : players) {
+        TickInput& input = tickInputs[pair.first * ring + currentTick % ring];
+        if (input.tick != currentTick) {
+            input.tick = currentTick;
+            input.confirmed = false;
+        }
+
+        // No input for the tick yet: the player holds what they held last tick
+        if (input.confirmed) {
+            pair.second.lastInput.SetButtons(input.buttons);
+        }
+        input.used = true;
+        input.usedButtons = pair.second.lastInput.GetButtons();
+    }
+}
+
+void GameServer::Rollback() {
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    uint32_t targetTick = currentTick;
+    uint32_t fromTick = rollbackTick;
+    rollbackTick = NO_ROLLBACK;
+
+    // The objects as the clients have them, the events so far are all out
+    if (eventReplication) {
+        objectsBeforeRollback.clear();
+        const uint32_t count = entities.Count();
+        for (uint32_t i = 0; i < count; i++) {
+            if (entities.active[i] && (entities.type[i] == TYPE_ASTEROID || entities.type[i] == TYPE_BULLET)) {
+                ObjectState state = { entities.IdAt(i), entities.posCurr[i], entities.velCurr[i] };
+                objectsBeforeRollback.push_back(state);
+            }
+        }
+    }
+
+    if (!RestoreWorldState(fromTick)) {
+        std::cerr << "No saved state to roll back to tick " << fromTick << std::endl;
+        return;
+    }
+
+    // Same inputs and random stream as the first time, apart from the corrected ones
+    resimulating = true;
+    while (currentTick < targetTick) {
+        SimulateTick();
+    }
+    resimulating = false;
+
+    if (eventReplication) {
+        CorrectObjectsAfterRollback();
+    }
+
+    // The end already announced did not happen with the corrected inputs, the match goes on
+    // and its real end is still to be announced
+    if (gameInProgress && matchCount == announcedEndMatch) {
+        announcedEndMatch = 0;
+    }
+
+    double elapsedUs = std::chrono::duration<double, std::micro>(
+        std::chrono::high_resolution_clock::now() - startTime).count();
+    uint32_t ticks = targetTick - fromTick;
+    rollbackStats.rollbacks++;
+    rollbackStats.resimulatedTicks += ticks;
+    rollbackStats.maxRollbackTicks = (std::max)(rollbackStats.maxRollbackTicks, ticks);
+    rollbackStats.totalRollbackUs += elapsedUs;
+    rollbackStats.maxRollbackUs = (std::max)(rollbackStats.maxRollbackUs, elapsedUs);
+}
+
+void GameServer::SendInputFrame() {
+    // Sent even when empty, the frames are the clients' tick clock
+    size_t sent = 0;
+    do {
+        size_t count = (std::min)(relayedInputs.size() - sent, INPUT_FRAME_MAX_ENTRIES);
+        std::vector<char> buffer(sizeof(InputFrameMessage) + count * sizeof(InputFrameEntry));
+        InputFrameMessage* msg = reinterpret_cast<InputFrameMessage*>(buffer.data());
+
+        msg->type = MessageType::INPUT_FRAME;
+        msg->clientID = 0; // Server ID
+        msg->sequence = 0;
+        msg->serverTick = currentTick;
+        msg->entryCount = static_cast<uint8_t>(count);
+        if (count > 0) {
+            memcpy(buffer.data() + sizeof(InputFrameMessage), relayedInputs.data() + sent,
+                count * sizeof(InputFrameEntry));
+        }
+
+        server.QueueToAll(buffer.data(), buffer.size());
+        sent += count;
+    } while (sent < relayedInputs.size());
+
+    relayedInputs.clear();
+}
+
+void GameServer::SetRandomSeed(uint64_t seed) {
+    // ResetGame reads these under the same lock to seed the next match
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    randomSeed = seed;
+    matchCount = 0;
+    announcedEndMatch = 0;
+}
+
+bool GameServer::Initialize(uint16_t port, size_t maxPlayers) {
     // Set up network callbacks
     server.SetConnectCallback([this](ClientID clientID) { OnClientConnect(clientID); });
     server.SetDisconnectCallback([this](ClientID clientID) { OnClientDisconnect(clientID); });
@@ -145,7 +381,13 @@ bool GameServer::Initialize(uint16_t port) {
         OnMessage(clientID, data, size);
         });
 
+    {
+        std::lock_guard<std::recursive_mutex> lock(gameObjectsMutex);
+        entities.Clear();
+    }
+
     // Initialize UDP server
+    server.SetMaxClients(maxPlayers);
     if (!server.Initialize(port)) {
         return false;
     }
@@ -163,37 +405,22 @@ void GameServer::Shutdown() {
         server.Shutdown();
         isRunning = false;
 
-        // Clean up player ships
+        // Clean up players and game objects
         {
-            std::lock_guard<std::mutex> lock(playersMutex);
-            for (auto& pair : players) {
-                if (pair.second.ship) {
-                    gameObjInstDestroy(pair.second.ship);
-                    pair.second.ship = nullptr;
-                }
-            }
+            std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+            std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
             players.clear();
-        }
-
-        // Clean up game objects
-        {
-            std::lock_guard<std::mutex> lock(gameObjectsMutex);
-
-            // Clean up asteroids
-            for (auto* asteroid : asteroids) {
-                if (asteroid) {
-                    gameObjInstDestroy(asteroid);
-                }
-            }
             asteroids.clear();
+            entities.Clear();
+            matchLog.Close();
+        }
 
-            // Clean up bullets
-            for (auto* bullet : bullets) {
-                if (bullet) {
-                    gameObjInstDestroy(bullet);
-                }
-            }
-            bullets.clear();
+        if (rollbackStats.stampedInputs > 0) {
+            std::cout << "Rollback: " << rollbackStats.stampedInputs << " inputs, "
+                << rollbackStats.lateInputs << " late, " << rollbackStats.mispredictions << " mispredicted, "
+                << rollbackStats.tooLateInputs << " too late, " << rollbackStats.rollbacks << " rollbacks over "
+                << rollbackStats.resimulatedTicks << " ticks (max " << rollbackStats.maxRollbackTicks
+                << "), max " << rollbackStats.maxRollbackUs << " us" << std::endl;
         }
 
         std::cout << "Game server shut down" << std::endl;
@@ -205,15 +432,70 @@ void GameServer::Update(float dt) {
         return;
     }
 
+    // The frame time is captured, the replay rebuilds the same ticks from it
+    server.CaptureTick(dt);
+
+    tickAccumulator += dt;
+
+    unsigned int ticksRun = 0;
+    while (tickAccumulator >= TICK_DT && ticksRun < MAX_TICKS_PER_UPDATE) {
+        Tick();
+        tickAccumulator -= TICK_DT;
+        ticksRun++;
+    }
+
+    // Too far behind: drop the backlog rather than spiral, keep the fraction
+    if (tickAccumulator >= TICK_DT) {
+        unsigned int behind = static_cast<unsigned int>(tickAccumulator / TICK_DT);
+        skippedTicks += behind;
+        tickAccumulator -= behind * TICK_DT;
+    }
+}
+
+void GameServer::Tick() {
+    // Joins, leaves and inputs from the network thread land between ticks, never inside
+    // one, so the match log orders them exactly as they were applied
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+
+    // A late input changed a tick already simulated
+    if (rollbackTick != NO_ROLLBACK) {
+        Rollback();
+    }
+
+    SimulateTick();
+}
+
+void GameServer::SimulateTick() {
+    if (!savedStates.empty()) {
+        SaveWorldState();
+    }
+
+    if (rollbackWindow > 0) {
+        ApplyTickInputs();
+    }
+
     // Update game state
     if (gameInProgress) {
-        UpdateGameState(dt);
+        UpdateGameState(TICK_DT);
+
+        // Snapshots go out on exact tick multiples. Rollback mode relays the inputs every
+        // tick instead and only sends a snapshot now and then to resync. A re-simulated
+        // tick has been sent already.
+        if (!resimulating) {
+            // Events first, a snapshot without the objects is checked against them
+            if (eventReplication) {
+                SendObjectEvents();
+            }
 
-        // Send game state updates at fixed intervals
-        gameStateTimer += dt;
-        if (gameStateTimer >= GAME_STATE_UPDATE_INTERVAL) {
-            SendGameState();
-            gameStateTimer = 0.0f;
+            if (rollbackWindow > 0) {
+                SendInputFrame();
+                if (currentTick % ROLLBACK_SNAPSHOT_INTERVAL == 0) {
+                    SendGameState();
+                }
+            }
+            else if (currentTick % SNAPSHOT_TICK_INTERVAL == 0) {
+                SendGameState();
+            }
         }
 
         // Check for game end
@@ -221,50 +503,352 @@ void GameServer::Update(float dt) {
     }
     else {
         // Check if we have enough players to start a new game
-        if (server.GetClientCount() > 0) {
+        if (!players.empty()) {
             // Start a new game
             ResetGame();
             gameInProgress = true;
-            std::cout << "Game started with " << server.GetClientCount() << " players" << std::endl;
+            if (!resimulating) {
+                std::cout << "Game started with " << players.size() << " players" << std::endl;
+            }
         }
     }
 
     // If game is over and timer expired, reset the game
     if (!gameInProgress && gameEndTimer > 0.0f) {
-        gameEndTimer -= dt;
+        gameEndTimer -= TICK_DT;
         if (gameEndTimer <= 0.0f) {
             // Reset and start a new game if we have players
-            if (server.GetClientCount() > 0) {
+            if (!players.empty()) {
                 ResetGame();
                 gameInProgress = true;
-                std::cout << "New game started with " << server.GetClientCount() << " players" << std::endl;
+                if (!resimulating) {
+                    std::cout << "New game started with " << players.size() << " players" << std::endl;
+                }
             }
         }
     }
+
+    // Everything queued this tick goes out together, with the objects a reset replaced
+    if (!resimulating) {
+        if (eventReplication) {
+            SendObjectEvents();
+        }
+        server.FlushOutgoing();
+    }
+
+    // Slots destroyed during the tick become reusable only now
+    {
+        std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+        entities.FlushDestroyed();
+    }
+
+    if (matchLog.IsOpen()) {
+        if (matchLogHashes) {
+            matchLog.WriteTick(ComputeStateHash());
+        }
+        else {
+            matchLog.WriteTick();
+        }
+    }
+
+    currentTick++;
 }
 
-void GameServer::OnClientConnect(ClientID clientID) {
-    std::cout << "Client " << (int)clientID << " connected" << std::endl;
+bool GameServer::RunCaptureReplay(const std::string& path, CaptureReplayStats& stats) {
+    PacketCaptureReader reader;
+    if (!reader.Open(path)) {
+        return false;
+    }
+
+    // Same callbacks as a live server, but no socket
+    server.SetConnectCallback([this](ClientID clientID) { OnClientConnect(clientID); });
+    server.SetDisconnectCallback([this](ClientID clientID) { OnClientDisconnect(clientID); });
+    server.SetMessageCallback([this](ClientID clientID, const void* data, size_t size) {
+        OnMessage(clientID, data, size);
+        });
 
     {
-        std::lock_guard<std::mutex> lock(playersMutex);
+        std::lock_guard<std::recursive_mutex> lock(gameObjectsMutex);
+        entities.Clear();
+    }
+
+    if (!server.InitializeReplay()) {
+        return false;
+    }
+
+    isRunning = true;
+    gameInProgress = false;
+    tickAccumulator = 0.0f;
+    currentTick = 0;
 
-        // Create player data
-        PlayerData newPlayer;
-        newPlayer.ship = nullptr;
-        newPlayer.isAlive = true;
-        newPlayer.score = 0;
-        newPlayer.lives = INITIAL_LIVES;
+    stats = CaptureReplayStats();
+    std::vector<double> tickTimes;
+
+    CaptureRecordHeader record;
+    std::vector<char> payload;
+    while (reader.Next(record, payload)) {
+        // The network thread checks the timeouts all the time, here every record is a moment
+        server.CheckReplayTimeouts(record.timestampUs);
+
+        switch (record.direction) {
+        case CaptureDirection::INBOUND:
+        {
+            sockaddr_in fromAddr = {};
+            fromAddr.sin_family = AF_INET;
+            fromAddr.sin_addr.s_addr = record.address;
+            fromAddr.sin_port = record.port;
+
+            server.InjectDatagram(payload.data(), payload.size(), fromAddr, record.timestampUs);
+            stats.inboundPackets++;
+            stats.inboundBytes += payload.size();
+            break;
+        }
+
+        case CaptureDirection::OUTBOUND:
+            // Regenerated by the replayed server, only counted
+            stats.capturedOutbound++;
+            break;
 
-        // Add to players map
-        players[clientID] = newPlayer;
+        case CaptureDirection::TICK:
+        {
+            float dt = 0.0f;
+            if (payload.size() == sizeof(dt)) {
+                memcpy(&dt, payload.data(), sizeof(dt));
+            }
+
+            auto tickStart = std::chrono::steady_clock::now();
+            Update(dt);
+            auto tickEnd = std::chrono::steady_clock::now();
+
+            double tickUs = std::chrono::duration<double, std::micro>(tickEnd - tickStart).count();
+            tickTimes.push_back(tickUs);
+            stats.totalTickUs += tickUs;
+            stats.maxTickUs = (std::max)(stats.maxTickUs, tickUs);
+            break;
+        }
+        }
+    }
+
+    stats.ticks = tickTimes.size();
+    if (!tickTimes.empty()) {
+        std::sort(tickTimes.begin(), tickTimes.end());
+        stats.p50TickUs = tickTimes[tickTimes.size() / 2];
+        stats.p99TickUs = tickTimes[(tickTimes.size() * 99) / 100];
+    }
+    stats.rateLimitedPackets = server.GetRateLimitStats().droppedPackets;
+
+    Shutdown();
+    return true;
+}
+
+bool GameServer::StartMatchLog(const std::string& path, bool withHashes) {
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    if (!players.empty()) {
+        std::cerr << "A match log must start before the first player joins" << std::endl;
+        return false;
+    }
+
+    if (rollbackWindow > 0) {
+        std::cerr << "A match log cannot record in rollback mode" << std::endl;
+        return false;
+    }
+
+    // Objects left over from the last match would not be in the replay
+    asteroids.clear();
+    entities.Clear();
+    gameEndTimer = 0.0f;
+
+    MatchLogFileHeader header;
+    header.randomSeed = randomSeed;
+    header.matchCount = matchCount;
+    if (!matchLog.Open(path, header)) {
+        return false;
+    }
+    matchLogHashes = withHashes;
+
+    std::cout << "Recording match log to " << path << std::endl;
+    return true;
+}
+
+void GameServer::StopMatchLog() {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    matchLog.Close();
+}
+
+bool GameServer::RunMatchLogReplay(const std::string& path, MatchReplayStats& stats) {
+    MatchLogReader reader;
+    if (!reader.Open(path)) {
+        return false;
+    }
+
+    // No socket: snapshots are still built and queued, so their cost is part of the tick
+    if (!server.InitializeReplay()) {
+        return false;
+    }
+
+    {
+        std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+        std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+        players.clear();
+        asteroids.clear();
+        entities.Clear();
     }
 
+    isRunning = true;
+    gameInProgress = false;
+    tickAccumulator = 0.0f;
+    currentTick = 0;
+    gameEndTimer = 0.0f;
+    randomSeed = reader.GetHeader().randomSeed;
+    matchCount = reader.GetHeader().matchCount;
+    announcedEndMatch = 0;
+
+    stats = MatchReplayStats();
+    std::vector<double> tickTimes;
+
+    MatchLogEntry entry;
+    while (reader.Next(entry)) {
+        switch (entry.kind) {
+        case MatchLogRecord::JOIN:
+            OnClientConnect(entry.clientID);
+            stats.events++;
+            break;
+
+        case MatchLogRecord::LEAVE:
+            OnClientDisconnect(entry.clientID);
+            stats.events++;
+            break;
+
+        case MatchLogRecord::INPUT:
+        {
+            PlayerInputMessage input;
+            input.clientID = entry.clientID;
+            input.SetButtons(entry.buttons);
+            ProcessPlayerInput(entry.clientID, &input);
+            stats.events++;
+            break;
+        }
+
+        case MatchLogRecord::TICK:
+        case MatchLogRecord::TICK_HASH:
+        {
+            uint32_t tick = currentTick;
+
+            auto tickStart = std::chrono::steady_clock::now();
+            Tick();
+            auto tickEnd = std::chrono::steady_clock::now();
+
+            double tickUs = std::chrono::duration<double, std::micro>(tickEnd - tickStart).count();
+            tickTimes.push_back(tickUs);
+            stats.totalTickUs += tickUs;
+            stats.maxTickUs = (std::max)(stats.maxTickUs, tickUs);
+
+            if (entry.kind == MatchLogRecord::TICK_HASH) {
+                stats.hashChecks++;
+                if (!stats.diverged && ComputeStateHash() != entry.hash) {
+                    stats.diverged = true;
+                    stats.divergedTick = tick;
+                    std::cout << "Match replay diverged at tick " << tick << std::endl;
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    stats.ticks = tickTimes.size();
+    if (!tickTimes.empty()) {
+        std::sort(tickTimes.begin(), tickTimes.end());
+        stats.p50TickUs = tickTimes[tickTimes.size() / 2];
+        stats.p99TickUs = tickTimes[(tickTimes.size() * 99) / 100];
+    }
+
+    Shutdown();
+    return true;
+}
+
+// FNV-1a, fed field by field so struct padding never reaches the hash
+static void HashBytes(uint64_t& hash, const void* data, size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+}
+
+uint64_t GameServer::ComputeStateHash() {
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    uint64_t hash = 0xCBF29CE484222325ull;
+
+    uint32_t count = entities.Count();
+    HashBytes(hash, &count, sizeof(count));
+    for (uint32_t i = 0; i < count; i++) {
+        EntityID id = entities.IdAt(i);
+        HashBytes(hash, &id, sizeof(id));
+    }
+    HashBytes(hash, entities.type.data(), count * sizeof(uint8_t));
+    HashBytes(hash, entities.active.data(), count * sizeof(uint8_t));
+    HashBytes(hash, entities.posCurr.data(), count * sizeof(SimVec2));
+    HashBytes(hash, entities.velCurr.data(), count * sizeof(SimVec2));
+    HashBytes(hash, entities.scale.data(), count * sizeof(AEVec2));
+    HashBytes(hash, entities.dirCurr.data(), count * sizeof(SimScalar));
+
+    HashBytes(hash, asteroids.data(), asteroids.size() * sizeof(EntityID));
+
+    for (auto& pair : players) {
+        HashBytes(hash, &pair.first, sizeof(pair.first));
+        HashBytes(hash, &pair.second.ship, sizeof(pair.second.ship));
+        HashBytes(hash, &pair.second.isAlive, sizeof(pair.second.isAlive));
+        HashBytes(hash, &pair.second.score, sizeof(pair.second.score));
+        HashBytes(hash, &pair.second.lives, sizeof(pair.second.lives));
+        HashBytes(hash, &pair.second.fireHeld, sizeof(pair.second.fireHeld));
+        for (unsigned int i = 0; i < pair.second.bullets.size(); i++) {
+            HashBytes(hash, &pair.second.bullets[i], sizeof(PlayerBullet));
+        }
+    }
+
+    uint64_t randomCounter = random.GetCounter();
+    HashBytes(hash, &gameInProgress, sizeof(gameInProgress));
+    HashBytes(hash, &gameEndTimer, sizeof(gameEndTimer));
+    HashBytes(hash, &randomCounter, sizeof(randomCounter));
+    return hash;
+}
+
+void GameServer::OnClientConnect(ClientID clientID) {
+    std::cout << "Client " << (int)clientID << " connected" << std::endl;
+
+    // Held for the whole event so it falls between two ticks
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+
+    if (matchLog.IsOpen()) {
+        matchLog.WriteEvent(MatchLogRecord::JOIN, clientID);
+    }
+
+    // The saved states before now do not have the player
+    rollbackFloor = currentTick;
+
+    // Create player data
+    PlayerData newPlayer;
+    newPlayer.ship = INVALID_ENTITY;
+    newPlayer.isAlive = true;
+    newPlayer.score = 0;
+    newPlayer.lives = INITIAL_LIVES;
+    newPlayer.fireHeld = false;
+
+    // Add to players map
+    players[clientID] = newPlayer;
+
+    // The new client knows no objects yet
+    objectSnapshotPending = true;
+
     // If game is in progress, add the player to the game
     if (gameInProgress) {
         CreatePlayerShip(clientID);
     }
-    else if (server.GetClientCount() == 1) {
+    else if (players.size() == 1) {
         // First player - start the game
         ResetGame();
         gameInProgress = true;
@@ -275,16 +859,23 @@ void GameServer::OnClientConnect(ClientID clientID) {
 void GameServer::OnClientDisconnect(ClientID clientID) {
     std::cout << "Client " << (int)clientID << " disconnected" << std::endl;
 
-    // Remove player ship and data
-    RemovePlayerShip(clientID);
+    // Held for the whole event so it falls between two ticks
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
 
-    {
-        std::lock_guard<std::mutex> lock(playersMutex);
-        players.erase(clientID);
+    if (matchLog.IsOpen()) {
+        matchLog.WriteEvent(MatchLogRecord::LEAVE, clientID);
     }
 
+    // The saved states before now still have the player
+    rollbackFloor = currentTick;
+
+    // Remove player ship, bullets and data
+    RemovePlayerShip(clientID);
+    RemovePlayerBullets(clientID);
+    players.erase(clientID);
+
     // If no players left, end game
-    if (server.GetClientCount() == 0) {
+    if (players.empty()) {
         gameInProgress = false;
         gameEndTimer = 0.0f;
         std::cout << "Game ended - no players remaining" << std::endl;
@@ -292,32 +883,39 @@ void GameServer::OnClientDisconnect(ClientID clientID) {
 }
 
 void GameServer::OnMessage(ClientID clientID, const void* data, size_t size) {
-    // Process message based on type
-    if (size < sizeof(NetworkMessage)) {
+    // Size checked and routed by message type; unregistered types are ignored
+    messageHandlers.Dispatch(clientID, data, size);
+}
+
+void GameServer::ProcessPlayerInput(ClientID clientID, const PlayerInputMessage* inputMsg) {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+
+    auto it = players.find(clientID);
+    if (it == players.end()) {
         return;
     }
 
-    const NetworkMessage* header = static_cast<const NetworkMessage*>(data);
-
-    switch (header->type) {
-    case MessageType::PLAYER_INPUT:
-        if (size >= sizeof(PlayerInputMessage)) {
-            const PlayerInputMessage* inputMsg = static_cast<const PlayerInputMessage*>(data);
-            ProcessPlayerInput(clientID, inputMsg);
+    // Only changes are logged, held buttons repeat in every input message
+    if (matchLog.IsOpen()) {
+        uint8_t buttons = inputMsg->GetButtons();
+        if (buttons != it->second.lastInput.GetButtons()) {
+            matchLog.WriteInput(clientID, buttons);
         }
-        break;
-
-    default:
-        // Ignore other message types
-        break;
     }
-}
 
-void GameServer::ProcessPlayerInput(ClientID clientID, const PlayerInputMessage* inputMsg) {
-    std::lock_guard<std::mutex> lock(playersMutex);
+    // The client's view of an earlier snapshot must hash like the snapshot did
+    if (worldHashes && inputMsg->ackHash != 0) {
+        const SentWorldHash& sent = sentWorldHashes[(inputMsg->ackTick / SNAPSHOT_TICK_INTERVAL) % WORLD_HASH_HISTORY];
+        if (sent.hash != 0 && sent.tick == inputMsg->ackTick && sent.hash != inputMsg->ackHash) {
+            worldHashMismatches++;
+            std::cout << "World hash mismatch with client " << (int)clientID << " at tick " << sent.tick
+                << ": server " << std::hex << sent.hash << ", client " << inputMsg->ackHash << std::dec << std::endl;
+        }
+    }
 
-    auto it = players.find(clientID);
-    if (it == players.end()) {
+    // Held for the tick it was stamped with, the tick applies it
+    if (rollbackWindow > 0) {
+        StampInput(clientID, inputMsg->inputTick != NO_INPUT_TICK ? inputMsg->inputTick : currentTick, inputMsg->GetButtons());
         return;
     }
 
@@ -326,131 +924,87 @@ void GameServer::ProcessPlayerInput(ClientID clientID, const PlayerInputMessage*
 }
 
 void GameServer::UpdateGameState(float dt) {
-    std::lock_guard<std::mutex> lockPlayers(playersMutex);
-    std::lock_guard<std::mutex> lockObjects(gameObjectsMutex);
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
 
     // Process player inputs and update ships
     for (auto& pair : players) {
         ClientID clientID = pair.first;
         PlayerData& player = pair.second;
 
-        if (player.ship && (player.ship->flag & FLAG_ACTIVE) && player.isAlive) {
-            GameObjInst* ship = player.ship;
+        if (entities.IsAlive(player.ship) && player.isAlive) {
+            uint32_t ship = entities.IndexOf(player.ship);
+            SimVec2& shipVel = entities.velCurr[ship];
+            SimScalar& shipDir = entities.dirCurr[ship];
 
             // Apply controls based on last input
             if (player.lastInput.up) {
                 // Apply forward acceleration
-                AEVec2 added;
-                AEVec2 acceleration_vec;
-                AEVec2Set(&added, cosf(ship->dirCurr), sinf(ship->dirCurr));
-                AEVec2Scale(&acceleration_vec, &added, SHIP_ACCEL_FORWARD * dt);
-                AEVec2Add(&ship->velCurr, &ship->velCurr, &acceleration_vec);
+                SimScalar acceleration = SimFromFloat(SHIP_ACCEL_FORWARD * dt);
+                shipVel.x += SimCos(shipDir) * acceleration;
+                shipVel.y += SimSin(shipDir) * acceleration;
             }
 
             if (player.lastInput.down) {
                 // Apply backward acceleration
-                AEVec2 added;
-                AEVec2 acceleration_vec;
-                AEVec2Set(&added, -cosf(ship->dirCurr), -sinf(ship->dirCurr));
-                AEVec2Scale(&acceleration_vec, &added, SHIP_ACCEL_BACKWARD * dt);
-                AEVec2Add(&ship->velCurr, &ship->velCurr, &acceleration_vec);
+                SimScalar acceleration = SimFromFloat(SHIP_ACCEL_BACKWARD * dt);
+                shipVel.x -= SimCos(shipDir) * acceleration;
+                shipVel.y -= SimSin(shipDir) * acceleration;
             }
 
             if (player.lastInput.left) {
                 // Rotate left
-                ship->dirCurr += SHIP_ROT_SPEED * dt;
-                ship->dirCurr = AEWrap(ship->dirCurr, -PI, PI);
+                shipDir += SimFromFloat(SHIP_ROT_SPEED * dt);
+                shipDir = SimWrapAngle(shipDir);
             }
 
             if (player.lastInput.right) {
                 // Rotate right
-                ship->dirCurr -= SHIP_ROT_SPEED * dt;
-                ship->dirCurr = AEWrap(ship->dirCurr, -PI, PI);
+                shipDir -= SimFromFloat(SHIP_ROT_SPEED * dt);
+                shipDir = SimWrapAngle(shipDir);
             }
 
             // Apply friction
-            AEVec2Scale(&ship->velCurr, &ship->velCurr, 0.99f);
-
-            // Fire bullet if requested
-            if (player.lastInput.fire) {
-                // Only fire if the fire button was just pressed
-                if (!player.lastInput.fire) {
-                    AEVec2 bulletVel;
-                    AEVec2Set(&bulletVel, cosf(ship->dirCurr), sinf(ship->dirCurr));
-                    AEVec2Scale(&bulletVel, &bulletVel, BULLET_SPEED);
-
-                    AEVec2 scale;
-                    AEVec2Set(&scale, BULLET_SCALE_X, BULLET_SCALE_Y);
-
-                    GameObjInst* bullet = gameObjInstCreate(TYPE_BULLET, &scale, &ship->posCurr, &bulletVel, ship->dirCurr);
-
-                    if (bullet) {
-                        // Store the client ID as owner of the bullet
-                        bullet->clientID = clientID;
-                        // Store creation time for lifetime management
-                        bullet->lifeTime = BULLET_LIFETIME;
-                        bullets.push_back(bullet);
-                    }
+            const SimScalar friction = SimFromFloat(0.99f);
+            shipVel.x *= friction;
+            shipVel.y *= friction;
+
+            // Fire a bullet when the fire button was just pressed and the ring has room
+            if (player.lastInput.fire && !player.fireHeld && !player.bullets.full()) {
+                const SimScalar speed = SimFromFloat(BULLET_SPEED);
+                SimVec2 bulletVel = MakeSimVec2(SimCos(shipDir) * speed, SimSin(shipDir) * speed);
+
+                AEVec2 scale;
+                AEVec2Set(&scale, BULLET_SCALE_X, BULLET_SCALE_Y);
+
+                EntityID bullet = entities.Create(TYPE_BULLET, scale, entities.posCurr[ship], bulletVel, shipDir);
+
+                if (bullet != INVALID_ENTITY) {
+                    // Store the client ID as owner of the bullet
+                    entities.cold[entities.IndexOf(bullet)].owner = clientID;
+                    LogObjectSpawn(bullet);
+                    // Gone BULLET_LIFETIME_TICKS - 1 ticks from now, when the BULLET_LIFETIME
+                    // countdown this replaces ran out
+                    PlayerBullet entry = { bullet, currentTick + BULLET_LIFETIME_TICKS - 1 };
+                    player.bullets.push_back(entry);
                 }
             }
+            player.fireHeld = player.lastInput.fire;
         }
     }
 
-    // Update all game objects
-    for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++) {
-        GameObjInst* pInst = sGameObjInstList + i;
+    // Integrate, wrap and update the bounding boxes of every entity in one pass.
+    // Bullets do not wrap, they expire before they reach an edge.
+    entities.Integrate(dt, WorldBounds(), (1u << TYPE_SHIP) | (1u << TYPE_ASTEROID));
 
-        // Skip non-active instances
-        if ((pInst->flag & FLAG_ACTIVE) == 0)
-            continue;
-
-        // Save previous position
-        pInst->posPrev.x = pInst->posCurr.x;
-        pInst->posPrev.y = pInst->posCurr.y;
-
-        // Update position based on velocity
-        pInst->posCurr.x += pInst->velCurr.x * dt;
-        pInst->posCurr.y += pInst->velCurr.y * dt;
-
-        // Update bullet lifetime
-        if (pInst->pObject->type == TYPE_BULLET) {
-            pInst->lifeTime -= dt;
-            if (pInst->lifeTime <= 0.0f) {
-                // Remove expired bullet
-                for (auto it = bullets.begin(); it != bullets.end(); ++it) {
-                    if (*it == pInst) {
-                        bullets.erase(it);
-                        break;
-                    }
-                }
-                gameObjInstDestroy(pInst);
-                continue;
-            }
-        }
-
-        // Wrap position for ships and asteroids
-        if (pInst->pObject->type == TYPE_SHIP || pInst->pObject->type == TYPE_ASTEROID) {
-            pInst->posCurr.x = AEWrap(pInst->posCurr.x, AEGfxGetWinMinX() - pInst->scale.x,
-                AEGfxGetWinMaxX() + pInst->scale.x);
-            pInst->posCurr.y = AEWrap(pInst->posCurr.y, AEGfxGetWinMinY() - pInst->scale.y,
-                AEGfxGetWinMaxY() + pInst->scale.y);
+    // Remove the expired bullets. They are at the front of their rings, the rest of each
+    // ring is younger.
+    for (auto& pair : players) {
+        RingBuffer<PlayerBullet, PLAYER_BULLET_CAPACITY>& ring = pair.second.bullets;
+        while (!ring.empty() && ring.front().expireTick <= currentTick) {
+            DestroyObject(ring.front().id);
+            ring.pop_front();
         }
-
-        // Update transformation matrix
-        AEMtx33 scale, rot, trans;
-        AEMtx33Scale(&scale, pInst->scale.x, pInst->scale.y);
-        AEMtx33Rot(&rot, pInst->dirCurr);
-        AEMtx33Trans(&trans, pInst->posCurr.x, pInst->posCurr.y);
-
-        AEMtx33 temp;
-        AEMtx33Concat(&temp, &rot, &scale);
-        AEMtx33Concat(&pInst->transform, &trans, &temp);
-
-        // Update bounding box
-        AEVec2 tmp;
-        AEVec2Scale(&tmp, &pInst->scale, BOUNDING_RECT_SIZE / 2.0f);
-        AEVec2Sub(&pInst->boundingBox.min, &pInst->posCurr, &tmp);
-        AEVec2Add(&pInst->boundingBox.max, &pInst->posCurr, &tmp);
     }
 
     // Check for collisions
@@ -459,128 +1013,287 @@ void GameServer::UpdateGameState(float dt) {
     // Spawn new asteroids if needed
     if (asteroids.size() < INITIAL_ASTEROID_COUNT && asteroids.size() < MAX_ASTEROID_COUNT) {
         // Random position at the edge of the screen
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<float> disX(AEGfxGetWinMinX(), AEGfxGetWinMaxX());
-        std::uniform_real_distribution<float> disY(AEGfxGetWinMinY(), AEGfxGetWinMaxY());
-        std::uniform_real_distribution<float> disVel(-60.0f, 60.0f);
-        std::uniform_real_distribution<float> disScale(0.8f, 1.5f);
-
-        float x, y;
-        int side = gen() % 4;
-        switch (side) {
+        SimScalar x, y;
+        switch (random.Below(4)) {
         case 0: // Top
-            x = disX(gen);
-            y = AEGfxGetWinMinY() - 20.0f;
+            x = SimRange(random, -WORLD_VIEW_HALF_WIDTH, WORLD_VIEW_HALF_WIDTH);
+            y = SimFromFloat(-WORLD_VIEW_HALF_HEIGHT - 20.0f);
             break;
         case 1: // Right
-            x = AEGfxGetWinMaxX() + 20.0f;
-            y = disY(gen);
+            x = SimFromFloat(WORLD_VIEW_HALF_WIDTH + 20.0f);
+            y = SimRange(random, -WORLD_VIEW_HALF_HEIGHT, WORLD_VIEW_HALF_HEIGHT);
             break;
         case 2: // Bottom
-            x = disX(gen);
-            y = AEGfxGetWinMaxY() + 20.0f;
+            x = SimRange(random, -WORLD_VIEW_HALF_WIDTH, WORLD_VIEW_HALF_WIDTH);
+            y = SimFromFloat(WORLD_VIEW_HALF_HEIGHT + 20.0f);
             break;
-        case 3: // Left
-            x = AEGfxGetWinMinX() - 20.0f;
-            y = disY(gen);
+        default: // Left
+            x = SimFromFloat(-WORLD_VIEW_HALF_WIDTH - 20.0f);
+            y = SimRange(random, -WORLD_VIEW_HALF_HEIGHT, WORLD_VIEW_HALF_HEIGHT);
             break;
         }
 
-        CreateAsteroid(x, y, disVel(gen), disVel(gen),
-            ASTEROID_MAX_SCALE_X * disScale(gen));
+        // Drawn one per statement, argument evaluation order is unspecified
+        SimScalar velX = SimRange(random, -60.0f, 60.0f);
+        SimScalar velY = SimRange(random, -60.0f, 60.0f);
+        float scale = SimToFloat(SimFromFloat(ASTEROID_MAX_SCALE_X) * SimRange(random, 0.8f, 1.5f));
+        CreateAsteroid(MakeSimVec2(x, y), MakeSimVec2(velX, velY), scale);
     }
 }
 
+// Box covering an object over the next dt, so the broadphase keeps every pair the swept
+// narrowphase can hit within the tick
+static AABB SweptBox(const EntityStore& entities, uint32_t index, float dt) {
+    AABB box = entities.boundingBox[index];
+    float dx = SimToFloat(entities.velCurr[index].x) * dt;
+    float dy = SimToFloat(entities.velCurr[index].y) * dt;
+    (dx < 0.0f ? box.min.x : box.max.x) += dx;
+    (dy < 0.0f ? box.min.y : box.max.y) += dy;
+    return box;
+}
+
+// Bounding box moved by a wrap offset from the broadphase
+static AABB OffsetBox(const AABB& box, const AEVec2& offset) {
+    AABB moved;
+    moved.min.x = box.min.x + offset.x;
+    moved.min.y = box.min.y + offset.y;
+    moved.max.x = box.max.x + offset.x;
+    moved.max.y = box.max.y + offset.y;
+    return moved;
+}
+
 void GameServer::CheckForCollisions() {
-    std::lock_guard<std::mutex> lockPlayers(playersMutex);
-    std::lock_guard<std::mutex> lockObjects(gameObjectsMutex);
-
-    // Check bullet-asteroid collisions
-    for (auto bulletIt = bullets.begin(); bulletIt != bullets.end();) {
-        GameObjInst* bullet = *bulletIt;
-        bool bulletDestroyed = false;
-
-        for (auto asteroidIt = asteroids.begin(); asteroidIt != asteroids.end();) {
-            GameObjInst* asteroid = *asteroidIt;
-
-            if ((bullet->flag & FLAG_ACTIVE) && (asteroid->flag & FLAG_ACTIVE)) {
-                float collisionTime;
-                if (CollisionIntersection_RectRect(bullet->boundingBox, bullet->velCurr,
-                    asteroid->boundingBox, asteroid->velCurr,
-                    collisionTime)) {
-                    // Collision detected!
-
-                    // Award points to the player who fired the bullet
-                    auto playerIt = players.find(bullet->clientID);
-                    if (playerIt != players.end()) {
-                        playerIt->second.score += 100;
-                    }
-
-                    // Split the asteroid if it's large enough
-                    if (asteroid->scale.x >= ASTEROID_MIN_SCALE_X * 2.0f) {
-                        SplitAsteroid(asteroid);
-                    }
-
-                    // Remove the asteroid
-                    asteroidIt = asteroids.erase(asteroidIt);
-                    gameObjInstDestroy(asteroid);
-
-                    // Remove the bullet
-                    bulletIt = bullets.erase(bulletIt);
-                    gameObjInstDestroy(bullet);
-                    bulletDestroyed = true;
-                    break;
-                }
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    // Asteroids split below are appended, only the ones present now take part this tick.
+    // Bullets are numbered by player position and ring position.
+    const uint32_t asteroidCount = static_cast<uint32_t>(asteroids.size());
+    asteroidHit.assign(asteroidCount, 0);
+    bulletHit.assign(players.size() * PLAYER_BULLET_CAPACITY, 0);
+
+    // Broadphase: bucket the asteroids by grid cell, only neighbours reach the narrowphase.
+    // The grid wraps at the world edges like the objects do.
+    asteroidGrid.Clear();
+    for (uint32_t i = 0; i < asteroidCount; i++) {
+        asteroidGrid.Insert(i, SweptBox(entities, entities.IndexOf(asteroids[i]), TICK_DT));
+    }
+    asteroidGrid.Build();
+
+    // Gather every bullet-asteroid and ship-asteroid contact with its time of impact
+    collisionEvents.clear();
+    uint32_t playerPosition = 0;
+    for (auto& pair : players) {
+        const RingBuffer<PlayerBullet, PLAYER_BULLET_CAPACITY>& ring = pair.second.bullets;
+        for (unsigned int i = 0; i < ring.size(); i++) {
+            uint32_t b = playerPosition * PLAYER_BULLET_CAPACITY + i;
+            unsigned int hits = CollideWithAsteroids(entities.IndexOf(ring[i].id));
+            for (unsigned int h = 0; h < hits; h++) {
+                CollisionEvent event = { candidateHitTimes[h], COLLISION_BULLET, b, candidateAsteroids[candidateHits[h]] };
+                collisionEvents.push_back(event);
             }
+        }
+        playerPosition++;
+    }
 
-            if (!bulletDestroyed) {
-                ++asteroidIt;
+    for (auto& pair : players) {
+        if (entities.IsAlive(pair.second.ship) && pair.second.isAlive) {
+            unsigned int hits = CollideWithAsteroids(entities.IndexOf(pair.second.ship));
+            for (unsigned int h = 0; h < hits; h++) {
+                CollisionEvent event = { candidateHitTimes[h], COLLISION_SHIP, pair.first, candidateAsteroids[candidateHits[h]] };
+                collisionEvents.push_back(event);
             }
         }
+    }
+
+    // Resolve the contacts in the order they happen: an asteroid goes to whatever reaches it
+    // first, a bullet takes out the first asteroid on its path. Ties are broken by the
+    // event fields so the outcome does not depend on the sort.
+    std::sort(collisionEvents.begin(), collisionEvents.end());
+
+    std::bitset<256> shipHit;
+    for (const CollisionEvent& event : collisionEvents) {
+        if (asteroidHit[event.asteroid]) {
+            continue;
+        }
+
+        if (event.kind == COLLISION_BULLET) {
+            if (bulletHit[event.other]) {
+                continue;
+            }
 
-        if (!bulletDestroyed) {
-            ++bulletIt;
+            // Collision detected!
+            uint32_t asteroid = entities.IndexOf(asteroids[event.asteroid]);
+
+            // Award points to the player who fired the bullet
+            (players.begin() + event.other / PLAYER_BULLET_CAPACITY)->second.score += 100;
+
+            // Split the asteroid if it's large enough
+            if (entities.scale[asteroid].x >= ASTEROID_MIN_SCALE_X * 2.0f) {
+                SplitAsteroid(asteroid);
+            }
+
+            // Both are removed after the loop, so the event positions stay valid until then
+            asteroidHit[event.asteroid] = 1;
+            bulletHit[event.other] = 1;
+        }
+        else {
+            // One life per tick at most, the asteroid stays
+            if (shipHit[event.other]) {
+                continue;
+            }
+            shipHit[event.other] = true;
+
+            PlayerData& player = players[static_cast<ClientID>(event.other)];
+            uint32_t ship = entities.IndexOf(player.ship);
+
+            // Collision detected - player loses a life
+            player.lives--;
+
+            if (player.lives <= 0) {
+                // Player is out of lives
+                player.isAlive = false;
+            }
+            else {
+                // Reset ship position
+                entities.posCurr[ship] = MakeSimVec2(SimFromFloat(0.0f), SimFromFloat(0.0f));
+                entities.velCurr[ship] = MakeSimVec2(SimFromFloat(0.0f), SimFromFloat(0.0f));
+                entities.dirCurr[ship] = SimFromFloat(0.0f);
+            }
+        }
+    }
+
+    // Remove everything that was hit, swapping the last handle into each hole. Walking
+    // down means the handle that moves is never one still to remove.
+    for (uint32_t i = asteroidCount; i-- > 0;) {
+        if (asteroidHit[i]) {
+            DestroyObject(asteroids[i]);
+            asteroids[i] = asteroids.back();
+            asteroids.pop_back();
         }
     }
 
-    // Check ship-asteroid collisions
+    // A bullet that hit leaves its ring and the ones behind it close up, still oldest first,
+    // so the ring only ever holds bullets in flight
+    playerPosition = 0;
     for (auto& pair : players) {
-        PlayerData& player = pair.second;
+        RingBuffer<PlayerBullet, PLAYER_BULLET_CAPACITY>& ring = pair.second.bullets;
+        const uint8_t* hit = &bulletHit[playerPosition * PLAYER_BULLET_CAPACITY];
+        bool anyHit = false;
+        for (unsigned int i = 0; i < ring.size(); i++) {
+            if (hit[i]) {
+                DestroyObject(ring[i].id);
+                ring[i].id = INVALID_ENTITY;
+                anyHit = true;
+            }
+        }
+        if (anyHit) {
+            ring.remove_if([](const PlayerBullet& bullet) { return bullet.id == INVALID_ENTITY; });
+        }
+        playerPosition++;
+    }
+}
 
-        if (player.ship && (player.ship->flag & FLAG_ACTIVE) && player.isAlive) {
-            for (auto asteroidIt = asteroids.begin(); asteroidIt != asteroids.end(); ++asteroidIt) {
-                GameObjInst* asteroid = *asteroidIt;
-
-                if (asteroid->flag & FLAG_ACTIVE) {
-                    float collisionTime;
-                    if (CollisionIntersection_RectRect(player.ship->boundingBox, player.ship->velCurr,
-                        asteroid->boundingBox, asteroid->velCurr,
-                        collisionTime)) {
-                        // Collision detected - player loses a life
-                        player.lives--;
-
-                        if (player.lives <= 0) {
-                            // Player is out of lives
-                            player.isAlive = false;
-                        }
-                        else {
-                            // Reset ship position
-                            AEVec2Set(&player.ship->posCurr, 0.0f, 0.0f);
-                            AEVec2Set(&player.ship->velCurr, 0.0f, 0.0f);
-                            player.ship->dirCurr = 0.0f;
-                        }
-
-                        break;
-                    }
-                }
+// Circle inside a bounding box
+static void InscribedCircle(const AABB& box, AEVec2& center, float& radius) {
+    center.x = (box.min.x + box.max.x) * 0.5f;
+    center.y = (box.min.y + box.max.y) * 0.5f;
+    radius = (std::min)(box.max.x - box.min.x, box.max.y - box.min.y) * 0.5f;
+}
+
+unsigned int GameServer::CollideWithAsteroids(uint32_t index) {
+    candidateAsteroids.clear();
+    candidateBoxes.clear();
+    candidateVelocities.clear();
+    candidateOffsets.clear();
+
+    asteroidGrid.Query(SweptBox(entities, index, TICK_DT), [&](uint32_t a, const AEVec2& offset) {
+        candidateAsteroids.push_back(a);
+#ifdef SIM_FIXED_POINT
+        candidateOffsets.push_back(offset);
+#else
+        uint32_t asteroid = entities.IndexOf(asteroids[a]);
+        candidateBoxes.push_back(OffsetBox(entities.boundingBox[asteroid], offset));
+        candidateVelocities.push_back(entities.velCurr[asteroid]);
+#endif
+        return true;
+    });
+
+    unsigned int count = static_cast<unsigned int>(candidateAsteroids.size());
+    candidateHits.resize(count);
+    candidateHitTimes.resize(count);
+    if (count == 0) {
+        return 0;
+    }
+
+#ifdef SIM_FIXED_POINT
+    // The float boxes only picked the candidates, the tests run on the fixed positions.
+    // An object is the box of its scale around its position, or the circle inside it.
+    const Fixed dt = SimFromFloat(TICK_DT);
+    const bool circle = TYPE_COLLIDER[entities.type[index]] == COLLIDER_CIRCLE;
+    const FixedVec2& center = entities.posCurr[index];
+    const FixedVec2& vel = entities.velCurr[index];
+    FixedVec2 half = { Fixed(entities.scale[index].x * 0.5f), Fixed(entities.scale[index].y * 0.5f) };
+
+    unsigned int hits = 0;
+    for (unsigned int i = 0; i < count; i++) {
+        uint32_t asteroid = entities.IndexOf(asteroids[candidateAsteroids[i]]);
+        FixedVec2 candidateCenter = { entities.posCurr[asteroid].x + Fixed(candidateOffsets[i].x),
+            entities.posCurr[asteroid].y + Fixed(candidateOffsets[i].y) };
+        FixedVec2 candidateHalf = { Fixed(entities.scale[asteroid].x * 0.5f), Fixed(entities.scale[asteroid].y * 0.5f) };
+
+        Fixed time;
+        bool hit;
+        if (circle) {
+            hit = FixedCollision_CircleCircle(center, (std::min)(half.x, half.y), vel,
+                candidateCenter, (std::min)(candidateHalf.x, candidateHalf.y), entities.velCurr[asteroid], dt, time);
+        }
+        else {
+            FixedVec2 min1 = { center.x - half.x, center.y - half.y };
+            FixedVec2 max1 = { center.x + half.x, center.y + half.y };
+            FixedVec2 min2 = { candidateCenter.x - candidateHalf.x, candidateCenter.y - candidateHalf.y };
+            FixedVec2 max2 = { candidateCenter.x + candidateHalf.x, candidateCenter.y + candidateHalf.y };
+            hit = FixedCollision_RectRect(min1, max1, vel, min2, max2, entities.velCurr[asteroid], dt, time);
+        }
+
+        if (hit) {
+            candidateHits[hits] = i;
+            candidateHitTimes[hits] = time.ToFloat();
+            hits++;
+        }
+    }
+    return hits;
+#else
+
+    // Asteroids are round, round objects take the circle test against them
+    if (TYPE_COLLIDER[entities.type[index]] == COLLIDER_CIRCLE) {
+        AEVec2 center;
+        float radius;
+        InscribedCircle(entities.boundingBox[index], center, radius);
+
+        unsigned int hits = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            AEVec2 candidateCenter;
+            float candidateRadius, time;
+            InscribedCircle(candidateBoxes[i], candidateCenter, candidateRadius);
+            if (CollisionIntersection_CircleCircle(center, radius, entities.velCurr[index],
+                candidateCenter, candidateRadius, candidateVelocities[i], TICK_DT, time)) {
+                candidateHits[hits] = i;
+                candidateHitTimes[hits] = time;
+                hits++;
             }
         }
+        return hits;
     }
+
+    return CollisionIntersection_RectRectBatch(entities.boundingBox[index], entities.velCurr[index],
+        candidateBoxes.data(), candidateVelocities.data(), count, TICK_DT,
+        candidateHits.data(), candidateHitTimes.data());
+#endif
 }
 
 void GameServer::CheckGameEndConditions() {
-    std::lock_guard<std::mutex> lock(playersMutex);
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
 
     // Count active players
     int activePlayers = 0;
@@ -591,55 +1304,74 @@ void GameServer::CheckGameEndConditions() {
     }
 
     // Game ends if no players are alive or if only one player remains in multiplayer
-    if (activePlayers == 0 || (server.GetClientCount() > 1 && activePlayers <= 1)) {
+    if (activePlayers == 0 || (players.size() > 1 && activePlayers <= 1)) {
         // Game over!
         gameInProgress = false;
         gameEndTimer = GAME_END_DURATION;
 
-        // Create game end message
-        GameEndMessage endMsg;
-        endMsg.type = MessageType::GAME_END;
-        endMsg.clientID = 0; // Server ID
-        endMsg.sequence = 0;
+        // Once per match: a tick simulated again after a rollback may end it again
+        if (matchCount != announcedEndMatch) {
+            SendGameEnd();
+        }
+    }
+}
 
-        // Find the winner (highest score)
-        uint32_t highestScore = 0;
-        ClientID winnerID = 0;
+void GameServer::SendGameEnd() {
+    // Create game end message
+    GameEndMessage endMsg;
+    endMsg.type = MessageType::GAME_END;
+    endMsg.clientID = 0; // Server ID
+    endMsg.sequence = 0;
 
-        int i = 0;
-        for (auto& pair : players) {
-            // Store scores in the message
-            if (i < 4) {
-                endMsg.scores[i] = pair.second.score;
-            }
+    // Find the winner (highest score)
+    uint32_t highestScore = 0;
+    ClientID winnerID = 0;
 
-            if (pair.second.score > highestScore) {
-                highestScore = pair.second.score;
-                winnerID = pair.first;
-            }
+    int i = 0;
+    for (auto& pair : players) {
+        // Store scores in the message
+        if (i < 4) {
+            endMsg.scores[i] = pair.second.score;
+        }
 
-            i++;
+        if (pair.second.score > highestScore) {
+            highestScore = pair.second.score;
+            winnerID = pair.first;
         }
 
-        endMsg.winnerID = winnerID;
-        endMsg.winnerScore = highestScore;
+        i++;
+    }
 
-        // Send game end message to all clients
-        server.BroadcastToAll(&endMsg, sizeof(endMsg));
+    endMsg.winnerID = winnerID;
+    endMsg.winnerScore = highestScore;
 
-        std::cout << "Game ended - Winner is Player " << (int)winnerID
-            << " with score " << highestScore << std::endl;
-    }
+    // Send game end message to all clients
+    server.QueueToAll(&endMsg, sizeof(endMsg));
+    announcedEndMatch = matchCount;
+    sentGameEnds++;
+
+    std::cout << "Game ended - Winner is Player " << (int)winnerID
+        << " with score " << highestScore << std::endl;
 }
 
 void GameServer::SendGameState() {
-    std::lock_guard<std::mutex> lockPlayers(playersMutex);
-    std::lock_guard<std::mutex> lockObjects(gameObjectsMutex);
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    // Event replication leaves the objects out between corrections; the hash still covers them
+    const bool withObjects = !eventReplication || objectSnapshotPending ||
+        currentTick % OBJECT_CORRECTION_INTERVAL == 0;
+    size_t liveBullets = 0;
+    for (auto& pair : players) {
+        liveBullets += pair.second.bullets.size();
+    }
+    const size_t asteroidCount = withObjects ? asteroids.size() : 0;
+    const size_t bulletCount = withObjects ? liveBullets : 0;
 
     // Calculate total size needed for the message
     size_t playerStateSize = sizeof(ShipState) * players.size();
-    size_t asteroidStateSize = sizeof(AsteroidState) * asteroids.size();
-    size_t bulletStateSize = sizeof(BulletState) * bullets.size();
+    size_t asteroidStateSize = sizeof(AsteroidState) * asteroidCount;
+    size_t bulletStateSize = sizeof(BulletState) * bulletCount;
 
     size_t totalSize = sizeof(GameStateMessage) + playerStateSize + asteroidStateSize + bulletStateSize;
 
@@ -650,11 +1382,16 @@ void GameServer::SendGameState() {
     // Set header data
     msg->type = MessageType::GAME_STATE;
     msg->clientID = 0; // Server ID
-    msg->sequence = 0;
+    msg->sequence = snapshotSequence++; // lets clients detect lost snapshots
+    msg->serverTick = currentTick;
     msg->playerCount = static_cast<uint8_t>(players.size());
-    msg->asteroidCount = static_cast<uint16_t>(asteroids.size());
-    msg->bulletCount = static_cast<uint16_t>(bullets.size());
+    msg->asteroidCount = static_cast<uint16_t>(asteroidCount);
+    msg->bulletCount = static_cast<uint16_t>(bulletCount);
     msg->gameStatus = gameInProgress ? 1 : 0;
+    msg->flags = withObjects ? 0 : GAME_STATE_OBJECTS_OMITTED;
+
+    // Summed while the states are filled, from the same floats the clients receive
+    WorldHash worldHash;
 
     // Add player ships data
     ShipState* shipStates = reinterpret_cast<ShipState*>(buffer.data() + sizeof(GameStateMessage));
@@ -665,14 +1402,16 @@ void GameServer::SendGameState() {
         PlayerData& player = pair.second;
 
         ShipState& shipState = shipStates[shipIndex++];
-        shipState.active = player.isAlive && player.ship && (player.ship->flag & FLAG_ACTIVE);
+        shipState.active = player.isAlive && entities.IsAlive(player.ship);
 
         if (shipState.active) {
-            shipState.posX = player.ship->posCurr.x;
-            shipState.posY = player.ship->posCurr.y;
-            shipState.dirCurr = player.ship->dirCurr;
-            shipState.velocityX = player.ship->velCurr.x;
-            shipState.velocityY = player.ship->velCurr.y;
+            uint32_t ship = entities.IndexOf(player.ship);
+            shipState.posX = SimToFloat(entities.posCurr[ship].x);
+            shipState.posY = SimToFloat(entities.posCurr[ship].y);
+            shipState.dirCurr = SimToFloat(entities.dirCurr[ship]);
+            shipState.velocityX = SimToFloat(entities.velCurr[ship].x);
+            shipState.velocityY = SimToFloat(entities.velCurr[ship].y);
+            worldHash.Add(WORLD_HASH_SHIP, shipState.posX, shipState.posY, shipState.velocityX, shipState.velocityY);
         }
         else {
             shipState.posX = 0.0f;
@@ -686,72 +1425,224 @@ void GameServer::SendGameState() {
         shipState.lives = player.lives;
     }
 
-    // Add asteroids data
+    // Asteroids are read straight from the entity arrays, which hold exactly the ones in
+    // the asteroids list
     AsteroidState* asteroidStates = reinterpret_cast<AsteroidState*>(
         buffer.data() + sizeof(GameStateMessage) + playerStateSize);
+    uint16_t asteroidIndex = 0;
 
-    for (size_t i = 0; i < asteroids.size(); i++) {
-        GameObjInst* asteroid = asteroids[i];
-        AsteroidState& asteroidState = asteroidStates[i];
+    const uint32_t count = entities.Count();
+    for (uint32_t i = 0; i < count; i++) {
+        if (!entities.active[i] || entities.type[i] != TYPE_ASTEROID) {
+            continue;
+        }
 
-        asteroidState.id = static_cast<uint16_t>(i);
-        asteroidState.active = (asteroid->flag & FLAG_ACTIVE) != 0;
-        asteroidState.posX = asteroid->posCurr.x;
-        asteroidState.posY = asteroid->posCurr.y;
-        asteroidState.velocityX = asteroid->velCurr.x;
-        asteroidState.velocityY = asteroid->velCurr.y;
-        asteroidState.scale = asteroid->scale.x;
+        if (!withObjects) {
+            if (worldHashes) {
+                worldHash.Add(WORLD_HASH_ASTEROID, SimToFloat(entities.posCurr[i].x), SimToFloat(entities.posCurr[i].y),
+                    SimToFloat(entities.velCurr[i].x), SimToFloat(entities.velCurr[i].y));
+            }
+            continue;
+        }
+
+        if (asteroidIndex < asteroidCount) {
+            AsteroidState& asteroidState = asteroidStates[asteroidIndex++];
+
+            asteroidState.id = EntityStore::SlotOf(entities.IdAt(i));
+            asteroidState.active = true;
+            asteroidState.posX = SimToFloat(entities.posCurr[i].x);
+            asteroidState.posY = SimToFloat(entities.posCurr[i].y);
+            asteroidState.velocityX = SimToFloat(entities.velCurr[i].x);
+            asteroidState.velocityY = SimToFloat(entities.velCurr[i].y);
+            asteroidState.scale = entities.scale[i].x;
+            worldHash.Add(WORLD_HASH_ASTEROID, asteroidState.posX, asteroidState.posY, asteroidState.velocityX,
+                asteroidState.velocityY);
+        }
     }
 
-    // Add bullets data
+    // Bullets straight from their owners' rings, oldest first
     BulletState* bulletStates = reinterpret_cast<BulletState*>(
         buffer.data() + sizeof(GameStateMessage) + playerStateSize + asteroidStateSize);
+    uint16_t bulletIndex = 0;
 
-    for (size_t i = 0; i < bullets.size(); i++) {
-        GameObjInst* bullet = bullets[i];
-        BulletState& bulletState = bulletStates[i];
+    for (auto& pair : players) {
+        const RingBuffer<PlayerBullet, PLAYER_BULLET_CAPACITY>& ring = pair.second.bullets;
+        for (unsigned int b = 0; b < ring.size(); b++) {
+            uint32_t i = entities.IndexOf(ring[b].id);
+
+            if (!withObjects) {
+                if (worldHashes) {
+                    worldHash.Add(WORLD_HASH_BULLET, SimToFloat(entities.posCurr[i].x), SimToFloat(entities.posCurr[i].y),
+                        SimToFloat(entities.velCurr[i].x), SimToFloat(entities.velCurr[i].y));
+                }
+                continue;
+            }
 
-        bulletState.id = static_cast<uint16_t>(i);
-        bulletState.active = (bullet->flag & FLAG_ACTIVE) != 0;
-        bulletState.ownerID = bullet->clientID;
-        bulletState.posX = bullet->posCurr.x;
-        bulletState.posY = bullet->posCurr.y;
-        bulletState.velocityX = bullet->velCurr.x;
-        bulletState.velocityY = bullet->velCurr.y;
+            BulletState& bulletState = bulletStates[bulletIndex++];
+
+            bulletState.id = EntityStore::SlotOf(ring[b].id);
+            bulletState.active = true;
+            bulletState.ownerID = pair.first;
+            bulletState.posX = SimToFloat(entities.posCurr[i].x);
+            bulletState.posY = SimToFloat(entities.posCurr[i].y);
+            bulletState.velocityX = SimToFloat(entities.velCurr[i].x);
+            bulletState.velocityY = SimToFloat(entities.velCurr[i].y);
+            worldHash.Add(WORLD_HASH_BULLET, bulletState.posX, bulletState.posY, bulletState.velocityX,
+                bulletState.velocityY);
+        }
+    }
+
+    if (worldHashes) {
+        msg->worldHash = worldHash.Value();
+        SentWorldHash& sent = sentWorldHashes[(currentTick / SNAPSHOT_TICK_INTERVAL) % WORLD_HASH_HISTORY];
+        sent.tick = currentTick;
+        sent.hash = msg->worldHash;
+    }
+    else {
+        msg->worldHash = 0;
+    }
+
+    if (withObjects) {
+        objectSnapshotPending = false;
     }
 
     // Send the game state to all clients
-    server.BroadcastToAll(buffer.data(), buffer.size());
+    server.QueueToAll(buffer.data(), buffer.size());
 }
 
-void GameServer::ResetGame() {
-    std::lock_guard<std::mutex> lockPlayers(playersMutex);
-    std::lock_guard<std::mutex> lockObjects(gameObjectsMutex);
+void GameServer::SendObjectEvents() {
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    // Records are packed into messages of at most MAX_PACKET_SIZE bytes
+    uint16_t eventCount = 0;
+    objectEvents.resize(sizeof(ObjectEventsMessage));
+
+    auto flush = [&]() {
+        ObjectEventsMessage* msg = reinterpret_cast<ObjectEventsMessage*>(objectEvents.data());
+        msg->type = MessageType::OBJECT_EVENTS;
+        msg->clientID = 0; // Server ID
+        msg->sequence = objectEventSequence++; // a gap makes the clients wait for a correction
+        msg->serverTick = currentTick;
+        msg->eventCount = eventCount;
+        server.QueueToAll(objectEvents.data(), objectEvents.size());
+
+        eventCount = 0;
+        objectEvents.resize(sizeof(ObjectEventsMessage));
+    };
+
+    auto append = [&](const void* record, size_t size) {
+        if (objectEvents.size() + size > MAX_PACKET_SIZE) {
+            flush();
+        }
+        const char* bytes = static_cast<const char*>(record);
+        objectEvents.insert(objectEvents.end(), bytes, bytes + size);
+        eventCount++;
+    };
+
+    // Objects the clients know that are gone. Before the spawns: a spawn can reuse the slot.
+    for (EntityID id : destroyedObjects) {
+        uint16_t slot = EntityStore::SlotOf(id);
+        if (replicatedObjects[slot] == id) {
+            ObjectDestroyRecord record;
+            record.kind = OBJECT_DESTROY;
+            record.id = slot;
+            append(&record, sizeof(record));
+            replicatedObjects[slot] = INVALID_ENTITY;
+        }
+    }
+    destroyedObjects.clear();
 
-    // Clear all game objects
-    for (auto* asteroid : asteroids) {
-        if (asteroid) {
-            gameObjInstDestroy(asteroid);
+    // Objects the clients do not know yet, with their state now. One gone again already
+    // is never sent.
+    for (EntityID id : spawnedObjects) {
+        uint16_t slot = EntityStore::SlotOf(id);
+        if (!entities.IsAlive(id) || replicatedObjects[slot] == id) {
+            continue;
         }
+
+        uint32_t i = entities.IndexOf(id);
+        ObjectSpawnRecord record;
+        record.kind = entities.type[i] == TYPE_ASTEROID ? OBJECT_SPAWN_ASTEROID : OBJECT_SPAWN_BULLET;
+        record.id = slot;
+        record.ownerID = entities.type[i] == TYPE_BULLET ? entities.cold[i].owner : 0;
+        record.posX = SimToFloat(entities.posCurr[i].x);
+        record.posY = SimToFloat(entities.posCurr[i].y);
+        record.velocityX = SimToFloat(entities.velCurr[i].x);
+        record.velocityY = SimToFloat(entities.velCurr[i].y);
+        record.scale = entities.scale[i].x;
+        append(&record, sizeof(record));
+        replicatedObjects[slot] = id;
     }
-    asteroids.clear();
+    spawnedObjects.clear();
+
+    // Quiet ticks send nothing
+    if (eventCount > 0) {
+        flush();
+    }
+}
+
+void GameServer::CorrectObjectsAfterRollback() {
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    // Same handle, position and velocity means the same path from here on. An object on
+    // another path is destroyed and spawned again: the events go out after the next tick,
+    // which may end it, and then only the destroy is sent.
+    for (const ObjectState& before : objectsBeforeRollback) {
+        if (!entities.IsAlive(before.id)) {
+            destroyedObjects.push_back(before.id);
+            continue;
+        }
+
+        uint32_t i = entities.IndexOf(before.id);
+        if (std::memcmp(&entities.posCurr[i], &before.pos, sizeof(SimVec2)) != 0 ||
+            std::memcmp(&entities.velCurr[i], &before.vel, sizeof(SimVec2)) != 0) {
+            destroyedObjects.push_back(before.id);
+            spawnedObjects.push_back(before.id);
+        }
+    }
+
+    // Objects the corrected inputs brought in
+    const uint32_t count = entities.Count();
+    for (uint32_t i = 0; i < count; i++) {
+        if (!entities.active[i] || (entities.type[i] != TYPE_ASTEROID && entities.type[i] != TYPE_BULLET)) {
+            continue;
+        }
 
-    for (auto* bullet : bullets) {
-        if (bullet) {
-            gameObjInstDestroy(bullet);
+        EntityID id = entities.IdAt(i);
+        if (replicatedObjects[EntityStore::SlotOf(id)] != id) {
+            spawnedObjects.push_back(id);
         }
     }
-    bullets.clear();
+}
+
+void GameServer::ResetGame() {
+    std::lock_guard<std::recursive_mutex> lockPlayers(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
+
+    // Every match draws from its own stream, derived from the server seed and match number
+    random.Seed(MatchRandom::Derive(randomSeed, matchCount));
+    if (!resimulating) {
+        std::cout << "Match " << matchCount << " of seed " << randomSeed << std::endl;
+    }
+    matchCount++;
+
+    // Clear all game objects
+    for (EntityID asteroid : asteroids) {
+        DestroyObject(asteroid);
+    }
+    asteroids.clear();
 
     // Reset player data and create ships
     for (auto& pair : players) {
         ClientID clientID = pair.first;
         PlayerData& player = pair.second;
 
-        if (player.ship) {
-            gameObjInstDestroy(player.ship);
-            player.ship = nullptr;
+        RemovePlayerBullets(clientID);
+
+        if (entities.IsAlive(player.ship)) {
+            entities.Destroy(player.ship);
         }
+        player.ship = INVALID_ENTITY;
 
         player.score = 0;
         player.lives = INITIAL_LIVES;
@@ -763,12 +1654,11 @@ void GameServer::ResetGame() {
 
     // Create initial asteroids
     CreateInitialAsteroids();
-
-    gameStateTimer = 0.0f;
 }
 
 void GameServer::CreatePlayerShip(ClientID clientID) {
-    std::lock_guard<std::mutex> lock(playersMutex);
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
 
     auto it = players.find(clientID);
     if (it == players.end()) {
@@ -776,21 +1666,22 @@ void GameServer::CreatePlayerShip(ClientID clientID) {
     }
 
     // Calculate spawn position based on player number
-    float spawnAngle = (static_cast<float>(clientID) - 1) * (2.0f * PI / 4.0f);
-    float spawnDist = 100.0f;
-    float spawnX = cosf(spawnAngle) * spawnDist;
-    float spawnY = sinf(spawnAngle) * spawnDist;
+    SimScalar spawnAngle = SimFromFloat((static_cast<float>(clientID) - 1) * (2.0f * PI / 4.0f));
+    SimScalar spawnDist = SimFromFloat(100.0f);
+    SimScalar spawnX = SimCos(spawnAngle) * spawnDist;
+    SimScalar spawnY = SimSin(spawnAngle) * spawnDist;
 
     // Create ship
-    AEVec2 scale, pos;
+    AEVec2 scale;
     AEVec2Set(&scale, SHIP_SCALE_X * 2.5f, SHIP_SCALE_Y * 2.5f);
-    AEVec2Set(&pos, spawnX, spawnY);
+    SimVec2 pos = MakeSimVec2(spawnX, spawnY);
+    SimVec2 vel = MakeSimVec2(SimFromFloat(0.0f), SimFromFloat(0.0f));
 
-    GameObjInst* ship = gameObjInstCreate(TYPE_SHIP, &scale, &pos, nullptr, spawnAngle + PI);
+    EntityID ship = entities.Create(TYPE_SHIP, scale, pos, vel, spawnAngle + SimFromFloat(PI));
 
-    if (ship) {
+    if (ship != INVALID_ENTITY) {
         // Store client ID with the ship
-        ship->clientID = clientID;
+        entities.cold[entities.IndexOf(ship)].owner = clientID;
 
         // Store ship in player data
         it->second.ship = ship;
@@ -799,89 +1690,107 @@ void GameServer::CreatePlayerShip(ClientID clientID) {
 }
 
 void GameServer::RemovePlayerShip(ClientID clientID) {
-    std::lock_guard<std::mutex> lock(playersMutex);
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
 
     auto it = players.find(clientID);
-    if (it != players.end() && it->second.ship) {
-        gameObjInstDestroy(it->second.ship);
-        it->second.ship = nullptr;
+    if (it != players.end() && it->second.ship != INVALID_ENTITY) {
+        if (entities.IsAlive(it->second.ship)) {
+            entities.Destroy(it->second.ship);
+        }
+        it->second.ship = INVALID_ENTITY;
         it->second.isAlive = false;
     }
 }
 
-void GameServer::CreateInitialAsteroids() {
-    std::lock_guard<std::mutex> lock(gameObjectsMutex);
+void GameServer::RemovePlayerBullets(ClientID clientID) {
+    std::lock_guard<std::recursive_mutex> lock(playersMutex);
+    std::lock_guard<std::recursive_mutex> lockObjects(gameObjectsMutex);
 
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> disPos(-250.0f, 250.0f);
-    std::uniform_real_distribution<float> disVel(-60.0f, 60.0f);
-    std::uniform_real_distribution<float> disScale(0.8f, 1.5f);
+    auto it = players.find(clientID);
+    if (it == players.end()) {
+        return;
+    }
+
+    RingBuffer<PlayerBullet, PLAYER_BULLET_CAPACITY>& ring = it->second.bullets;
+    for (unsigned int i = 0; i < ring.size(); i++) {
+        DestroyObject(ring[i].id);
+    }
+    ring.clear();
+}
+
+void GameServer::CreateInitialAsteroids() {
+    std::lock_guard<std::recursive_mutex> lock(gameObjectsMutex);
 
     for (unsigned int i = 0; i < INITIAL_ASTEROID_COUNT; i++) {
         // Generate position away from the center (where players spawn)
-        float posX, posY;
-        float distFromCenter;
+        SimScalar posX, posY;
+        SimScalar distFromCenter;
 
         do {
-            posX = disPos(gen);
-            posY = disPos(gen);
-            distFromCenter = sqrtf(posX * posX + posY * posY);
-        } while (distFromCenter < 150.0f); // Keep asteroids away from player spawn positions
-
-        CreateAsteroid(posX, posY, disVel(gen), disVel(gen),
-            ASTEROID_MAX_SCALE_X * disScale(gen));
+            posX = SimRange(random, -250.0f, 250.0f);
+            posY = SimRange(random, -250.0f, 250.0f);
+            distFromCenter = SimLength(posX, posY);
+        } while (distFromCenter < SimFromFloat(150.0f)); // Keep asteroids away from player spawn positions
+
+        SimScalar velX = SimRange(random, -60.0f, 60.0f);
+        SimScalar velY = SimRange(random, -60.0f, 60.0f);
+        float scale = SimToFloat(SimFromFloat(ASTEROID_MAX_SCALE_X) * SimRange(random, 0.8f, 1.5f));
+        CreateAsteroid(MakeSimVec2(posX, posY), MakeSimVec2(velX, velY), scale);
     }
 }
 
-void GameServer::CreateAsteroid(float x, float y, float velX, float velY, float scale) {
-    std::lock_guard<std::mutex> lock(gameObjectsMutex);
+void GameServer::CreateAsteroid(const SimVec2& pos, const SimVec2& vel, float scale) {
+    std::lock_guard<std::recursive_mutex> lock(gameObjectsMutex);
 
-    AEVec2 pos, vel, scaleVec;
-    AEVec2Set(&pos, x, y);
-    AEVec2Set(&vel, velX, velY);
+    AEVec2 scaleVec;
     AEVec2Set(&scaleVec, scale, scale);
 
-    GameObjInst* asteroid = gameObjInstCreate(TYPE_ASTEROID, &scaleVec, &pos, &vel, 0.0f);
+    EntityID asteroid = entities.Create(TYPE_ASTEROID, scaleVec, pos, vel, SimFromFloat(0.0f));
 
-    if (asteroid) {
+    if (asteroid != INVALID_ENTITY) {
         asteroids.push_back(asteroid);
+        LogObjectSpawn(asteroid);
     }
 }
 
-void GameServer::SplitAsteroid(GameObjInst* asteroid) {
-    if (!asteroid || !(asteroid->flag & FLAG_ACTIVE)) {
+void GameServer::SplitAsteroid(uint32_t index) {
+    if (!entities.active[index]) {
         return;
     }
 
+    SimVec2 pos = entities.posCurr[index];
+    SimVec2 vel = entities.velCurr[index];
+
     // Create two smaller asteroids
-    float newScale = asteroid->scale.x * 0.6f;
+    float newScale = entities.scale[index].x * 0.6f;
 
     if (newScale < ASTEROID_MIN_SCALE_X) {
         return; // Too small to split
     }
 
     // Calculate split velocities (perpendicular to original)
-    float perpX = -asteroid->velCurr.y;
-    float perpY = asteroid->velCurr.x;
-    float perpLen = sqrtf(perpX * perpX + perpY * perpY);
+    SimScalar perpX = -vel.y;
+    SimScalar perpY = vel.x;
+    SimScalar perpLen = SimLength(perpX, perpY);
 
-    if (perpLen > 0.0f) {
+    if (perpLen > SimFromFloat(0.0f)) {
         perpX /= perpLen;
         perpY /= perpLen;
     }
 
-    float splitSpeed = 30.0f;
+    SimScalar splitSpeed = SimFromFloat(30.0f);
+    SimScalar keep = SimFromFloat(0.8f);
 
     // Create first fragment
-    float vel1X = asteroid->velCurr.x * 0.8f + perpX * splitSpeed;
-    float vel1Y = asteroid->velCurr.y * 0.8f + perpY * splitSpeed;
+    SimScalar vel1X = vel.x * keep + perpX * splitSpeed;
+    SimScalar vel1Y = vel.y * keep + perpY * splitSpeed;
 
-    CreateAsteroid(asteroid->posCurr.x, asteroid->posCurr.y, vel1X, vel1Y, newScale);
+    CreateAsteroid(pos, MakeSimVec2(vel1X, vel1Y), newScale);
 
     // Create second fragment
-    float vel2X = asteroid->velCurr.x * 0.8f - perpX * splitSpeed;
-    float vel2Y = asteroid->velCurr.y * 0.8f - perpY * splitSpeed;
+    SimScalar vel2X = vel.x * keep - perpX * splitSpeed;
+    SimScalar vel2Y = vel.y * keep - perpY * splitSpeed;
 
-    CreateAsteroid(asteroid->posCurr.x, asteroid->posCurr.y, vel2X, vel2Y, newScale);
-}
\ No newline at end of file
+    CreateAsteroid(pos, MakeSimVec2(vel2X, vel2Y), newScale);
+}
@@ -13,6 +13,10 @@ prior written consent of DigiPen Institute of Technology is prohibited.
 /******************************************************************************/
 
 #include "main.h"
+#include "SpatialHash.h"
+#include "MatchRandom.h"
+#include <chrono>
+#include <random>
 #include <iostream>
 #include <string> 
 /******************************************************************************/
@@ -78,6 +82,7 @@ struct GameObj
 {
 	unsigned long		type;		// object type
 	AEGfxVertexList *	pMesh;		// This will hold the triangles which will form the shape of the object
+	COLLIDER_SHAPE		collider;	// shape used by the collision test
 };
 
 // ---------------------------------------------------------------------------
@@ -118,6 +123,25 @@ static unsigned long		sGameObjNum;								// The number of defined game objects
 static GameObjInst			sGameObjInstList[GAME_OBJ_INST_NUM_MAX];	// Each element in this array represents a unique game object instance (sprite)
 static unsigned long		sGameObjInstNum;							// The number of used game object instances
 
+// stack of unused slots of sGameObjInstList, so creating and destroying an instance is O(1)
+static unsigned long		sGameObjInstFree[GAME_OBJ_INST_NUM_MAX];	// Indices of the unused instances, the next one to use on top
+static unsigned long		sGameObjInstFreeNum;						// The number of unused instances
+
+// packed list of the used slots, so the per frame passes only visit live instances
+static unsigned long		sGameObjInstActive[GAME_OBJ_INST_NUM_MAX];	// Indices of the used instances, in creation order
+static unsigned long		sGameObjInstActiveNum;						// The number of entries in sGameObjInstActive
+static unsigned long		sGameObjInstDead[GAME_OBJ_INST_NUM_MAX];	// Indices destroyed this frame, still in sGameObjInstActive
+static unsigned long		sGameObjInstDeadNum;						// The number of entries in sGameObjInstDead
+
+// collision broadphase over the ships and bullets, rebuilt every frame.
+// intentionally not wrapped (no SetWorld): objects wrap only once they are a whole
+// scale outside the window, each type at its own distance, so the screen is no torus
+// and nothing touches anything across its edges
+static SpatialHash			sCollisionGrid(64.0f);
+
+// random numbers of the current game, seeded in the "Initialize" function
+static MatchRandom			sRandom;
+
 // pointer to the ship object
 static GameObjInst *		spShip;										// Pointer to the "Ship" game object instance
 
@@ -136,6 +160,16 @@ static unsigned long		sScore;										// Current score
 GameObjInst *		gameObjInstCreate (unsigned long type, AEVec2* scale,
 											   AEVec2 * pPos, AEVec2 * pVel, float dir);
 void				gameObjInstDestroy(GameObjInst * pInst);
+void				gameObjInstListReset();
+void				gameObjInstFlushDestroyed();
+bool				gameObjInstCollide(GameObjInst * pInst1, GameObjInst * pInst2, float & tFirst);
+AABB				gameObjInstSweptBox(GameObjInst * pInst);
+void				gameObjInstCollisionGridBuild(unsigned long activeNum);
+unsigned long		gameObjInstFirstHit(GameObjInst * pInst, unsigned long activeNum);
+
+// functions to spawn replacement asteroids, random numbers are only drawn when one spawns
+void				asteroidRandomEdgePosition(AEVec2 & pos);
+void				asteroidCreateRandom(AEVec2 const & pos);
 
 void				Helper_Wall_Collision();
 
@@ -161,7 +195,7 @@ void GameStateAsteroidsLoad(void)
 	// zero the game object instance array
 	memset(sGameObjInstList, 0, sizeof(GameObjInst) * GAME_OBJ_INST_NUM_MAX);
 	// No game object instances (sprites) at this point
-	sGameObjInstNum = 0;
+	gameObjInstListReset();
 
 	// The ship object instance hasn't been created yet, so this "spShip" pointer is initialized to 0
 	spShip = nullptr;
@@ -175,6 +209,7 @@ void GameStateAsteroidsLoad(void)
 
 	pObj = sGameObjList + sGameObjNum++;
 	pObj->type = TYPE_SHIP;
+	pObj->collider = COLLIDER_CIRCLE;
 
 	AEGfxMeshStart();
 	AEGfxTriAdd(
@@ -197,6 +232,7 @@ void GameStateAsteroidsLoad(void)
 
 	pObj = sGameObjList + sGameObjNum++;
 	pObj->type = TYPE_BULLET;
+	pObj->collider = COLLIDER_RECT;
 
 	AEGfxMeshStart();
 	AEGfxTriAdd(
@@ -218,6 +254,7 @@ void GameStateAsteroidsLoad(void)
 
 	pObj = sGameObjList + sGameObjNum++;
 	pObj->type = TYPE_ASTEROID;
+	pObj->collider = COLLIDER_CIRCLE;
 
 	AEGfxMeshStart();
 	AEGfxTriAdd(
@@ -240,6 +277,7 @@ void GameStateAsteroidsLoad(void)
 	// =========================
 	pObj = sGameObjList + sGameObjNum++;
 	pObj->type = TYPE_WALL;
+	pObj->collider = COLLIDER_RECT;
 
 	AEGfxMeshStart();
 	AEGfxTriAdd(
@@ -336,6 +374,12 @@ void GameStateAsteroidsInit(void)
 	sScore      = 0;
 	sShipLives  = SHIP_INITIAL_NUM;
 	over = false;
+
+	// a fixed seed replays the same game for the same input, otherwise every game differs
+	if (g_randomSeedFixed)
+		sRandom.Seed(g_randomSeed);
+	else
+		sRandom.Seed((static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}());
 }
 
 /******************************************************************************/
@@ -428,9 +472,9 @@ void GameStateAsteroidsUpdate(void)
 	//  -- For all instances
 	// [DO NOT UPDATE THIS PARAGRAPH'S CODE]
 	// ======================================================================
-	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
+	for (unsigned long i = 0; i < sGameObjInstActiveNum; i++)
 	{
-		GameObjInst* pInst = sGameObjInstList + i;
+		GameObjInst* pInst = sGameObjInstList + sGameObjInstActive[i];
 
 		// skip non-active object
 		if ((pInst->flag & FLAG_ACTIVE) == 0)
@@ -454,9 +498,9 @@ void GameStateAsteroidsUpdate(void)
 	//	-- New position of the active instance is updated here with the velocity calculated earlier
 	// ======================================================================
 
-	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; ++i)
+	for (unsigned long i = 0; i < sGameObjInstActiveNum; ++i)
 	{
-		GameObjInst* instance = sGameObjInstList + i;
+		GameObjInst* instance = sGameObjInstList + sGameObjInstActive[i];
 		if ((instance->flag & FLAG_ACTIVE) == 0)
 			continue;
 		AEVec2 tmp;
@@ -507,114 +551,49 @@ void GameStateAsteroidsUpdate(void)
 	*/
 
 	if (over == false) {
-		for (int i = 0; i < GAME_OBJ_INST_NUM_MAX; ++i) {
-			GameObjInst* oi1 = sGameObjInstList + i;
+		// broadphase over the ships and bullets, the only objects an asteroid can hit.
+		// instances created below have no bounding box yet, they are checked next frame
+		const unsigned long activeNum = sGameObjInstActiveNum;
+		gameObjInstCollisionGridBuild(activeNum);
 
-			if ((oi1->flag & FLAG_ACTIVE) == 0)
+		for (unsigned long i = 0; i < activeNum; ++i) {
+			GameObjInst* oi1 = sGameObjInstList + sGameObjInstActive[i];
+
+			if ((oi1->flag & FLAG_ACTIVE) == 0 || oi1->pObject->type != TYPE_ASTEROID)
+				continue;// only asteroids look for hits
+
+			// the ship or bullet touching the asteroid that was created first
+			unsigned long first = gameObjInstFirstHit(oi1, activeNum);
+			if (first == activeNum)
 				continue;
-			if (oi1->pObject->type == TYPE_ASTEROID) {// oi1 = asteroid
-				for (int j = 0; j < GAME_OBJ_INST_NUM_MAX; ++j) {
-					// Skip checking against itself
-					/*if (i == j)
-						continue;*/
-					int random_value_x = 0;
-					int random_value_y = 0;
-					int random_x = 0;
-					int random_y = 0;
-					int random_vel_x = 0;
-					int random_vel_y = 0;
-
-					if (rand() % 2 == 0) { // Generate a random value within the range -500 to -400
-						random_value_x = -400 - rand() % 101;
-						random_x = -400 - rand() % 101;
-					}
-					else { // Generate a random value within the range 400 to 500
-						random_value_x = 400 + rand() % 101;
-						random_x = 400 + rand() % 101;
-					}
-					if (rand() % 2 == 0) { // Generate a random value within the range -400 to -300
-						random_value_y = -300 - rand() % 101;
-						random_y = -300 - rand() % 101;
-					}
-					else { // Generate a random value within the range 300 to 400
-						random_value_y = 300 + rand() % 101;
-						random_y = 300 + rand() % 101;
-					}
-					GameObjInst* oi2 = sGameObjInstList + j;
-					if ((oi2->flag & FLAG_ACTIVE) == 0 || oi2->pObject->type == TYPE_ASTEROID)
-						continue;//oi2 is not active or oi2 is an asteroid
-
-					if (oi2->pObject->type == TYPE_SHIP) { // collision between ship and asteroid
-						float tFirst;
-						if (CollisionIntersection_RectRect(oi2->boundingBox, oi2->velCurr, oi1->boundingBox, oi1->velCurr, tFirst)) { // check collision between ship and asteroid
-							gameObjInstDestroy(oi1);// destroy asteroid
-							onValueChange = true;
-							sShipLives--;
-							//reset ship 
-							AEVec2Set(&oi2->posCurr, 0.0f, 0.0f);
-							AEVec2Set(&oi2->velCurr, 0.0f, 0.0f);
-
-							oi2->dirCurr = 0.0f;
-							//add 1 asteroid
-							float randomValue = 0.5f + (float)rand() / (float)(RAND_MAX / 1.0f);
-							if (rand() % 2 == 0) {
-								random_vel_x = -30 - rand() % 101;
-							}
-							else {
-								random_vel_x = 30 + rand() % 101;
-							}
-							if (rand() % 2 == 0) {
-								random_vel_y = -30 - rand() % 101;
-							}
-							else {
-								random_vel_y = 30 + rand() % 101;
-							}
-							AEVec2 pos{}, vel{}, scale{};
-							pos.x = (float)random_x;		pos.y = (float)random_y;
-							vel.x = (float)random_vel_x;		vel.y = (float)random_vel_y;
-							AEVec2Set(&scale, ASTEROID_MAX_SCALE_X * randomValue,
-								ASTEROID_MAX_SCALE_Y * randomValue);
-							gameObjInstCreate(TYPE_ASTEROID, &scale, &pos, &vel, 0.0f);
-
-						}
-					}
-					else {
-						if (oi2->pObject->type == TYPE_BULLET) {// collision between bullet and asteroid
-							float tFirst;
-							if (CollisionIntersection_RectRect(oi1->boundingBox, oi1->velCurr, oi2->boundingBox, oi2->velCurr, tFirst)) {
-								//update game behaviour
-								sScore += 100;
-								onValueChange = true;
-								gameObjInstDestroy(oi1);// destroy the asteroid
-								gameObjInstDestroy(oi2);// destroy the bullet
-
-								// randomly add 1 or  2 asteroid
-								int add_asteroid_num = rand() % 2;
-								AEVec2 pos{}, vel{}, scale{};
-								for (int k = 0; k < add_asteroid_num + 1; ++k) {
-									float randomValue = 0.5f + (float)rand() / (float)(RAND_MAX / 1.0f);
-									if (rand() % 2 == 0) {
-										random_vel_x = -30 - rand() % 101;// rand from -130 to -100
-									}
-									else {
-										random_vel_x = 30 + rand() % 101;// rand from 130 to 100
-									}
-									if (rand() % 2 == 0) {
-										random_vel_y = -30 - rand() % 101;//rand from -130 to 100
-									}
-									else {
-										random_vel_y = 30 + rand() % 101;// rand from -130 ro 100
-									}
-									pos.x = (float)random_value_x;		pos.y = (float)random_value_y;
-									vel.x = (float)random_vel_x;		vel.y = (float)random_vel_y;
-									AEVec2Set(&scale, ASTEROID_MAX_SCALE_X * randomValue,
-										ASTEROID_MAX_SCALE_Y * randomValue);
-									gameObjInstCreate(TYPE_ASTEROID, &scale, &pos, &vel, 0.0f);
-								}
-							}
-						}
-					}
-				}
+
+			GameObjInst* oi2 = sGameObjInstList + sGameObjInstActive[first];
+			AEVec2 pos{};
+			if (oi2->pObject->type == TYPE_SHIP) { // collision between ship and asteroid
+				gameObjInstDestroy(oi1);// destroy asteroid
+				onValueChange = true;
+				sShipLives--;
+				//reset ship 
+				AEVec2Set(&oi2->posCurr, 0.0f, 0.0f);
+				AEVec2Set(&oi2->velCurr, 0.0f, 0.0f);
+
+				oi2->dirCurr = 0.0f;
+				//add 1 asteroid
+				asteroidRandomEdgePosition(pos);
+				asteroidCreateRandom(pos);
+			}
+			else {// collision between bullet and asteroid
+				//update game behaviour
+				sScore += 100;
+				onValueChange = true;
+				gameObjInstDestroy(oi1);// destroy the asteroid
+				gameObjInstDestroy(oi2);// destroy the bullet
+
+				// randomly add 1 or  2 asteroid
+				asteroidRandomEdgePosition(pos);
+				int add_asteroid_num = (int)sRandom.Below(2);
+				for (int k = 0; k < add_asteroid_num + 1; ++k)
+					asteroidCreateRandom(pos);
 			}
 		}
 	}
@@ -629,9 +608,9 @@ void GameStateAsteroidsUpdate(void)
 	//			(Homing missiles are not required for the Asteroids project)
 	//		-- Update a particle effect (Not required for the Asteroids project)
 	// ===================================================================
-	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
+	for (unsigned long i = 0; i < sGameObjInstActiveNum; i++)
 	{
-		GameObjInst * pInst = sGameObjInstList + i;
+		GameObjInst * pInst = sGameObjInstList + sGameObjInstActive[i];
 
 		// skip non-active object
 		if ((pInst->flag & FLAG_ACTIVE) == 0)
@@ -676,9 +655,9 @@ void GameStateAsteroidsUpdate(void)
 	// calculate the matrix for all objects
 	// =====================================================================
 
-	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
+	for (unsigned long i = 0; i < sGameObjInstActiveNum; i++)
 	{
-		GameObjInst * pInst = sGameObjInstList + i;
+		GameObjInst * pInst = sGameObjInstList + sGameObjInstActive[i];
 		AEMtx33		 trans{}, rot{}, scale{};
 
 		UNREFERENCED_PARAMETER(trans);
@@ -702,6 +681,9 @@ void GameStateAsteroidsUpdate(void)
 		AEMtx33Concat(&pInst->transform, &trans, &pInst->transform);
 
 	}
+
+	// drop the instances destroyed this frame from the active list
+	gameObjInstFlushDestroyed();
 }
 
 /******************************************************************************/
@@ -726,9 +708,9 @@ void GameStateAsteroidsDraw(void)
 	char strBuffer[1024];
 
 	// draw all object instances in the list
-	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
+	for (unsigned long i = 0; i < sGameObjInstActiveNum; i++)
 	{
-		GameObjInst * pInst = sGameObjInstList + i;
+		GameObjInst * pInst = sGameObjInstList + sGameObjInstActive[i];
 
 		// skip non-active object
 		if ((pInst->flag & FLAG_ACTIVE) == 0)
@@ -827,10 +809,14 @@ void GameStateAsteroidsDraw(void)
 void GameStateAsteroidsFree(void)
 {
 	// kill all object instances in the array using "gameObjInstDestroy"
-	for (unsigned long int i = 0; i < GAME_OBJ_INST_NUM_MAX; ++i) {
-		GameObjInst* pInt = sGameObjInstList + i;
-		gameObjInstDestroy(pInt);
+	for (unsigned long int i = 0; i < sGameObjInstActiveNum; ++i) {
+		GameObjInst* pInt = sGameObjInstList + sGameObjInstActive[i];
+		if (pInt->flag & FLAG_ACTIVE)
+			gameObjInstDestroy(pInt);
 	}
+
+	// restarts hand out the slots in the same order as the first run
+	gameObjInstListReset();
 }
 
 /******************************************************************************/
@@ -850,6 +836,114 @@ void GameStateAsteroidsUnload(void)
 	AEGfxDestroyFont(pFont);
 }
 
+/******************************************************************************/
+/*!
+	Times the asteroid collision phase of a frame against the number of
+	instances, grid against testing every ship and bullet, and prints both
+	with the number of asteroids hit. The instances are spread over the
+	screen, then over an area growing with their number so the density
+	stays that of 64 instances on screen. Uses the instance pools without
+	meshes and leaves them empty, run it before the game state is loaded.
+*/
+/******************************************************************************/
+void GameStateAsteroidsCollisionBenchmark(void)
+{
+	typedef std::chrono::steady_clock Clock;
+	const unsigned long counts[] = { 64, 128, 256, 512, 1024, 2048 };
+	const double budgetUs = 250000.0;
+
+	memset(sGameObjList, 0, sizeof(GameObj) * GAME_OBJ_NUM_MAX);
+	sGameObjNum = 0;
+	const unsigned long types[] = { TYPE_SHIP, TYPE_BULLET, TYPE_ASTEROID };
+	const COLLIDER_SHAPE colliders[] = { COLLIDER_CIRCLE, COLLIDER_RECT, COLLIDER_CIRCLE };
+	for (int k = 0; k < 3; ++k) {
+		GameObj* pObj = sGameObjList + sGameObjNum++;
+		pObj->type = types[k];
+		pObj->collider = colliders[k];
+	}
+
+	float dt = g_dt;
+	g_dt = 1.0f / 60.0f;
+	MatchRandom random(9);
+
+	std::cout << "Client collision phase per frame, grid against every pair" << std::endl;
+	for (int layout = 0; layout < 2; ++layout)
+	for (unsigned long n : counts) {
+		// one ship, then bullets and asteroids in turn
+		float spread = layout == 0 ? 1.0f : sqrtf(n / 64.0f);
+		memset(sGameObjInstList, 0, sizeof(GameObjInst) * GAME_OBJ_INST_NUM_MAX);
+		gameObjInstListReset();
+		for (unsigned long i = 0; i < n; ++i) {
+			unsigned long type = i == 0 ? TYPE_SHIP : (i % 2 ? TYPE_ASTEROID : TYPE_BULLET);
+			AEVec2 pos{}, vel{}, scale{};
+			AEVec2Set(&pos, random.Range(-500.0f, 500.0f) * spread, random.Range(-400.0f, 400.0f) * spread);
+			if (type == TYPE_BULLET) {
+				AEVec2Set(&scale, BULLET_SCALE_X, BULLET_SCALE_Y);
+				AEVec2Set(&vel, BULLET_SPEED, 0.0f);
+			}
+			else {
+				float size = type == TYPE_SHIP ? SHIP_SCALE_X : random.Range(ASTEROID_MIN_SCALE_X, ASTEROID_MAX_SCALE_X);
+				AEVec2Set(&scale, size, size);
+				AEVec2Set(&vel, random.Range(-130.0f, 130.0f), random.Range(-130.0f, 130.0f));
+			}
+
+			GameObjInst* pInst = gameObjInstCreate(type, &scale, &pos, &vel, 0.0f);
+			AEVec2 half;
+			AEVec2Scale(&half, &pInst->scale, BOUNDING_RECT_SIZE / 2.0f);
+			AEVec2Sub(&pInst->boundingBox.min, &pInst->posCurr, &half);
+			AEVec2Add(&pInst->boundingBox.max, &pInst->posCurr, &half);
+		}
+
+		const unsigned long activeNum = sGameObjInstActiveNum;
+		unsigned long gridHits = 0, pairHits = 0, gridFrames = 0, pairFrames = 0;
+		double gridUs = 0.0, pairUs = 0.0;
+
+		Clock::time_point start = Clock::now();
+		do {
+			gridHits = 0;
+			gameObjInstCollisionGridBuild(activeNum);
+			for (unsigned long i = 0; i < activeNum; ++i) {
+				GameObjInst* oi1 = sGameObjInstList + sGameObjInstActive[i];
+				if (oi1->pObject->type == TYPE_ASTEROID && gameObjInstFirstHit(oi1, activeNum) != activeNum)
+					gridHits++;
+			}
+			gridFrames++;
+			gridUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		} while (gridUs < budgetUs);
+
+		// the loop the grid replaced: every asteroid against every ship and bullet
+		start = Clock::now();
+		do {
+			pairHits = 0;
+			for (unsigned long i = 0; i < activeNum; ++i) {
+				GameObjInst* oi1 = sGameObjInstList + sGameObjInstActive[i];
+				if (oi1->pObject->type != TYPE_ASTEROID)
+					continue;
+				for (unsigned long j = 0; j < activeNum; ++j) {
+					GameObjInst* oi2 = sGameObjInstList + sGameObjInstActive[j];
+					float tFirst;
+					if (oi2->pObject->type == TYPE_ASTEROID)
+						continue;
+					if (oi2->pObject->type == TYPE_SHIP ? gameObjInstCollide(oi2, oi1, tFirst) : gameObjInstCollide(oi1, oi2, tFirst)) {
+						pairHits++;
+						break;
+					}
+				}
+			}
+			pairFrames++;
+			pairUs = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+		} while (pairUs < budgetUs);
+
+		std::cout << (layout == 0 ? "on screen, " : "same density, ") << n << " instances: grid " << gridUs / gridFrames << " us, every pair "
+			<< pairUs / pairFrames << " us, " << gridHits << " / " << pairHits << " asteroids hit"
+			<< (gridHits == pairHits ? "" : "  MISMATCH") << std::endl;
+	}
+
+	gameObjInstListReset();
+	sGameObjNum = 0;
+	g_dt = dt;
+}
+
 /******************************************************************************/
 /*!
 	
@@ -866,29 +960,26 @@ GameObjInst * gameObjInstCreate(unsigned long type,
 
 	AE_ASSERT_PARM(type < sGameObjNum);
 	
-	// loop through the object instance list to find a non-used object instance
-	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
-	{
-		GameObjInst * pInst = sGameObjInstList + i;
-
-		// check if current instance is not used
-		if (pInst->flag == 0)
-		{
-			// it is not used => use it to create the new instance
-			pInst->pObject	= sGameObjList + type;
-			pInst->flag		= FLAG_ACTIVE;
-			pInst->scale	= *scale;
-			pInst->posCurr	= pPos ? *pPos : zero;
-			pInst->velCurr	= pVel ? *pVel : zero;
-			pInst->dirCurr	= dir;
-			
-			// return the newly created instance
-			return pInst;
-		}
-	}
-
 	// cannot find empty slot => return 0
-	return 0;
+	if (sGameObjInstFreeNum == 0)
+		return 0;
+
+	// take the unused instance on top of the free stack
+	unsigned long index = sGameObjInstFree[--sGameObjInstFreeNum];
+	GameObjInst * pInst = sGameObjInstList + index;
+	sGameObjInstActive[sGameObjInstActiveNum++] = index;
+
+	// it is not used => use it to create the new instance
+	pInst->pObject	= sGameObjList + type;
+	pInst->flag		= FLAG_ACTIVE;
+	pInst->scale	= *scale;
+	pInst->posCurr	= pPos ? *pPos : zero;
+	pInst->velCurr	= pVel ? *pVel : zero;
+	pInst->dirCurr	= dir;
+	sGameObjInstNum++;
+	
+	// return the newly created instance
+	return pInst;
 }
 
 /******************************************************************************/
@@ -898,12 +989,172 @@ GameObjInst * gameObjInstCreate(unsigned long type,
 /******************************************************************************/
 void gameObjInstDestroy(GameObjInst * pInst)
 {
+#ifdef _DEBUG
+	// destroying an unused instance means a stale pointer is still around
+	AE_ASSERT_MESG(pInst->flag != 0, "gameObjInstDestroy: instance %d destroyed twice",
+		(int)(pInst - sGameObjInstList));
+#endif
+
 	// if instance is destroyed before, just return
 	if (pInst->flag == 0)
 		return;
 
 	// zero out the flag
 	pInst->flag = 0;
+
+	// the slot is given back by gameObjInstFlushDestroyed, so loops over the active
+	// list can destroy instances while they run
+	sGameObjInstDead[sGameObjInstDeadNum++] = (unsigned long)(pInst - sGameObjInstList);
+	sGameObjInstNum--;
+}
+
+/******************************************************************************/
+/*!
+	Remove the instances destroyed since the last call from the active list
+	(keeping the creation order) and make their slots available again.
+*/
+/******************************************************************************/
+void gameObjInstFlushDestroyed()
+{
+	if (sGameObjInstDeadNum == 0)
+		return;
+
+	unsigned long kept = 0;
+	for (unsigned long i = 0; i < sGameObjInstActiveNum; i++)
+	{
+		if (sGameObjInstList[sGameObjInstActive[i]].flag != 0)
+			sGameObjInstActive[kept++] = sGameObjInstActive[i];
+	}
+	sGameObjInstActiveNum = kept;
+
+	for (unsigned long i = 0; i < sGameObjInstDeadNum; i++)
+		sGameObjInstFree[sGameObjInstFreeNum++] = sGameObjInstDead[i];
+	sGameObjInstDeadNum = 0;
+}
+
+/******************************************************************************/
+/*!
+	Mark every instance slot as unused. Slots are handed out from index 0 up.
+*/
+/******************************************************************************/
+void gameObjInstListReset()
+{
+	for (unsigned long i = 0; i < GAME_OBJ_INST_NUM_MAX; i++)
+		sGameObjInstFree[i] = GAME_OBJ_INST_NUM_MAX - 1 - i;
+
+	sGameObjInstFreeNum = GAME_OBJ_INST_NUM_MAX;
+	sGameObjInstActiveNum = 0;
+	sGameObjInstDeadNum = 0;
+	sGameObjInstNum = 0;
+}
+
+/******************************************************************************/
+/*!
+	Swept collision test of two instances over the frame. Two round objects
+	are tested as the circles inside their bounding boxes, the cheap squared
+	distance test catches most hits; any other pair is tested as boxes.
+*/
+/******************************************************************************/
+bool gameObjInstCollide(GameObjInst * pInst1, GameObjInst * pInst2, float & tFirst)
+{
+	if (pInst1->pObject->collider != COLLIDER_CIRCLE || pInst2->pObject->collider != COLLIDER_CIRCLE)
+		return CollisionIntersection_RectRect(pInst1->boundingBox, pInst1->velCurr, pInst2->boundingBox, pInst2->velCurr, tFirst);
+
+	AABB& box1 = pInst1->boundingBox;
+	AABB& box2 = pInst2->boundingBox;
+	AEVec2 center1{}, center2{};
+	center1.x = (box1.min.x + box1.max.x) * 0.5f;		center1.y = (box1.min.y + box1.max.y) * 0.5f;
+	center2.x = (box2.min.x + box2.max.x) * 0.5f;		center2.y = (box2.min.y + box2.max.y) * 0.5f;
+	float radius1 = AEMin(box1.max.x - box1.min.x, box1.max.y - box1.min.y) * 0.5f;
+	float radius2 = AEMin(box2.max.x - box2.min.x, box2.max.y - box2.min.y) * 0.5f;
+
+	return CollisionIntersection_CircleCircle(center1, radius1, pInst1->velCurr, center2, radius2, pInst2->velCurr, g_dt, tFirst);
+}
+
+/******************************************************************************/
+/*!
+	Bounding box extended by the distance the instance moves this frame, it
+	covers every position the swept collision test can hit it at
+*/
+/******************************************************************************/
+AABB gameObjInstSweptBox(GameObjInst * pInst)
+{
+	AABB box = pInst->boundingBox;
+	float dx = pInst->velCurr.x * g_dt;
+	float dy = pInst->velCurr.y * g_dt;
+	(dx < 0.0f ? box.min.x : box.max.x) += dx;
+	(dy < 0.0f ? box.min.y : box.max.y) += dy;
+	return box;
+}
+
+/******************************************************************************/
+/*!
+	Fill the collision grid with the ships and bullets among the first
+	activeNum entries of the active list, swept over the frame
+*/
+/******************************************************************************/
+void gameObjInstCollisionGridBuild(unsigned long activeNum)
+{
+	sCollisionGrid.Clear();
+	for (unsigned long j = 0; j < activeNum; ++j) {
+		GameObjInst* oi2 = sGameObjInstList + sGameObjInstActive[j];
+		if ((oi2->flag & FLAG_ACTIVE) == 0)
+			continue;
+		if (oi2->pObject->type == TYPE_SHIP || oi2->pObject->type == TYPE_BULLET)
+			sCollisionGrid.Insert(j, gameObjInstSweptBox(oi2));
+	}
+	sCollisionGrid.Build();
+}
+
+/******************************************************************************/
+/*!
+	Active list index of the earliest created ship or bullet the asteroid
+	hits this frame, or activeNum if none. The grid must have been built
+	with gameObjInstCollisionGridBuild.
+*/
+/******************************************************************************/
+unsigned long gameObjInstFirstHit(GameObjInst * pInst, unsigned long activeNum)
+{
+	unsigned long first = activeNum;
+	sCollisionGrid.Query(gameObjInstSweptBox(pInst), [&](uint32_t j, const AEVec2&) {
+		GameObjInst* oi2 = sGameObjInstList + sGameObjInstActive[j];
+		float tFirst;
+		if (j < first && (oi2->flag & FLAG_ACTIVE) != 0 &&
+			(oi2->pObject->type == TYPE_SHIP ? gameObjInstCollide(oi2, pInst, tFirst) : gameObjInstCollide(pInst, oi2, tFirst)))
+			first = j;
+		return true;
+	});
+	return first;
+}
+
+/******************************************************************************/
+/*!
+	Random position just outside the screen, 400 to 500 from the center
+	horizontally and 300 to 400 vertically, where new asteroids come from
+*/
+/******************************************************************************/
+void asteroidRandomEdgePosition(AEVec2 & pos)
+{
+	pos.x = (float)(sRandom.Below(2) == 0 ? -400 - (int)sRandom.Below(101) : 400 + (int)sRandom.Below(101));
+	pos.y = (float)(sRandom.Below(2) == 0 ? -300 - (int)sRandom.Below(101) : 300 + (int)sRandom.Below(101));
+}
+
+/******************************************************************************/
+/*!
+	Creates an asteroid at pos with a random size and a random speed of 30
+	to 130 along each axis
+*/
+/******************************************************************************/
+void asteroidCreateRandom(AEVec2 const & pos)
+{
+	float randomValue = 0.5f + sRandom.NextFloat();
+
+	AEVec2 start = pos, vel{}, scale{};
+	vel.x = (float)(sRandom.Below(2) == 0 ? -30 - (int)sRandom.Below(101) : 30 + (int)sRandom.Below(101));
+	vel.y = (float)(sRandom.Below(2) == 0 ? -30 - (int)sRandom.Below(101) : 30 + (int)sRandom.Below(101));
+	AEVec2Set(&scale, ASTEROID_MAX_SCALE_X * randomValue,
+		ASTEROID_MAX_SCALE_Y * randomValue);
+	gameObjInstCreate(TYPE_ASTEROID, &scale, &start, &vel, 0.0f);
 }
 
 
@@ -12,15 +12,212 @@ prior written consent of DigiPen Institute of Technology is prohibited.
  */
  /******************************************************************************/
 
+// GameServer.h pulls in winsock2.h, which must come before the windows.h included by main.h
+#include "GameServer.h"
+#include "ServerTools.h"
 #include "main.h"
+#include <cstdlib>
 #include <memory>
+#include <string>
+#include <iostream>
 
 // ---------------------------------------------------------------------------
 // Globals
 float	 g_dt;
 double	 g_appTime;
+unsigned long long	g_randomSeed;
+bool				g_randomSeedFixed;
 
 
+/******************************************************************************/
+/*!
+	Replays a server packet capture headless and prints the server CPU cost
+	per tick
+*/
+/******************************************************************************/
+static void RunCaptureReplayTool(const std::string& path)
+{
+	GameServer replayServer;
+	CaptureReplayStats stats;
+
+	if (g_randomSeedFixed)
+		replayServer.SetRandomSeed(g_randomSeed);
+
+	if (!replayServer.RunCaptureReplay(path, stats))
+	{
+		std::cout << "Capture replay failed: " << path << std::endl;
+		return;
+	}
+
+	std::cout << "Replayed " << stats.ticks << " ticks, "
+		<< stats.inboundPackets << " inbound packets (" << stats.inboundBytes << " bytes), "
+		<< stats.capturedOutbound << " captured outbound packets, "
+		<< stats.rateLimitedPackets << " dropped by the rate limiter" << std::endl;
+	if (stats.ticks > 0)
+	{
+		std::cout << "Server CPU per tick (us): mean " << stats.totalTickUs / stats.ticks
+			<< ", p50 " << stats.p50TickUs
+			<< ", p99 " << stats.p99TickUs
+			<< ", max " << stats.maxTickUs << std::endl;
+	}
+}
+
+/******************************************************************************/
+/*!
+	Re-simulates a match log headless, prints the CPU cost per tick and
+	whether the world hashes recorded in the log still match
+*/
+/******************************************************************************/
+static void RunMatchReplayTool(const std::string& path)
+{
+	GameServer replayServer;
+	MatchReplayStats stats;
+
+	if (!replayServer.RunMatchLogReplay(path, stats))
+	{
+		std::cout << "Match replay failed: " << path << std::endl;
+		return;
+	}
+
+	std::cout << "Replayed " << stats.ticks << " ticks, " << stats.events << " events" << std::endl;
+	if (stats.ticks > 0)
+	{
+		std::cout << "Server CPU per tick (us): mean " << stats.totalTickUs / stats.ticks
+			<< ", p50 " << stats.p50TickUs
+			<< ", p99 " << stats.p99TickUs
+			<< ", max " << stats.maxTickUs << std::endl;
+	}
+	if (stats.diverged)
+		std::cout << "World hash differs from the log from tick " << stats.divergedTick << std::endl;
+	else if (stats.hashChecks > 0)
+		std::cout << "World hash matched the log on all " << stats.hashChecks << " ticks" << std::endl;
+}
+
+/******************************************************************************/
+/*!
+	Rolls a headless rollback mode server back across the tick a match ends
+	in and checks that the clients are told of the end exactly once
+*/
+/******************************************************************************/
+static void RunRollbackEndCheckTool()
+{
+	GameServer checkServer;
+	unsigned int gameEnds = 0;
+
+	if (g_randomSeedFixed)
+		checkServer.SetRandomSeed(g_randomSeed);
+
+	bool passed = ServerTools::RunRollbackGameEndCheck(checkServer, gameEnds);
+	std::cout << "Rollback across a match end: " << gameEnds << " GAME_END sent, "
+		<< (passed ? "passed" : "FAILED") << std::endl;
+}
+
+/******************************************************************************/
+/*!
+	Runs the developer tool requested on the command line, if any.
+	"-seed <n>" fixes the random seed of the game and of replayed captures,
+	so the same input plays out the same way. It may come before a tool.
+	"-replay-capture <file>" replays a server packet capture headless.
+	"-replay-match <file>" re-simulates a match log headless; match logs
+	carry their own seed.
+	"-check-rollback-end" checks that a rollback across the end of a match
+	announces the end once.
+	"-bench-collisions" times the server collision pass against the number
+	of entities.
+	"-bench-integrate" checks the entity integration kernel against the
+	loop it replaced and times both.
+	"-check-swept-batch" compares the batched swept box test with the
+	scalar one, hits and time bits.
+	"-bench-shape-pairs" times the box and circle narrowphase tests per
+	pair.
+	"-bench-client-collisions" times the collision phase of a client frame
+	against the number of instances.
+	"-bench-step" times server ticks of a seeded world, build with and
+	without SIM_FIXED_POINT to compare.
+	Returns true if a tool ran and the application should exit.
+*/
+/******************************************************************************/
+static bool RunCommandLineTool(const char* command_line)
+{
+	std::string args = command_line ? command_line : "";
+	const std::string seedFlag = "-seed ";
+	const std::string replayCaptureFlag = "-replay-capture ";
+	const std::string replayMatchFlag = "-replay-match ";
+	const std::string rollbackEndFlag = "-check-rollback-end";
+	const std::string collisionBenchFlag = "-bench-collisions";
+	const std::string integrateBenchFlag = "-bench-integrate";
+	const std::string sweptBatchCheckFlag = "-check-swept-batch";
+	const std::string shapePairBenchFlag = "-bench-shape-pairs";
+	const std::string clientCollisionBenchFlag = "-bench-client-collisions";
+	const std::string stepBenchFlag = "-bench-step";
+
+	if (args.compare(0, seedFlag.size(), seedFlag) == 0)
+	{
+		char* end = nullptr;
+		g_randomSeed = std::strtoull(args.c_str() + seedFlag.size(), &end, 10);
+		g_randomSeedFixed = true;
+
+		size_t next = std::string(end).find_first_not_of(' ');
+		args = next == std::string::npos ? "" : std::string(end).substr(next);
+	}
+
+	if (args.compare(0, replayCaptureFlag.size(), replayCaptureFlag) == 0)
+	{
+		RunCaptureReplayTool(args.substr(replayCaptureFlag.size()));
+		return true;
+	}
+
+	if (args.compare(0, replayMatchFlag.size(), replayMatchFlag) == 0)
+	{
+		RunMatchReplayTool(args.substr(replayMatchFlag.size()));
+		return true;
+	}
+
+	if (args.compare(0, rollbackEndFlag.size(), rollbackEndFlag) == 0)
+	{
+		RunRollbackEndCheckTool();
+		return true;
+	}
+
+	if (args.compare(0, collisionBenchFlag.size(), collisionBenchFlag) == 0)
+	{
+		ServerTools::RunCollisionBenchmark();
+		return true;
+	}
+
+	if (args.compare(0, integrateBenchFlag.size(), integrateBenchFlag) == 0)
+	{
+		ServerTools::RunIntegrateBenchmark();
+		return true;
+	}
+
+	if (args.compare(0, sweptBatchCheckFlag.size(), sweptBatchCheckFlag) == 0)
+	{
+		ServerTools::RunSweptBatchCheck();
+		return true;
+	}
+
+	if (args.compare(0, shapePairBenchFlag.size(), shapePairBenchFlag) == 0)
+	{
+		ServerTools::RunShapePairBenchmark();
+		return true;
+	}
+
+	if (args.compare(0, clientCollisionBenchFlag.size(), clientCollisionBenchFlag) == 0)
+	{
+		GameStateAsteroidsCollisionBenchmark();
+		return true;
+	}
+
+	if (args.compare(0, stepBenchFlag.size(), stepBenchFlag) == 0)
+	{
+		ServerTools::RunStepBenchmark();
+		return true;
+	}
+
+	return false;
+}
+
 /******************************************************************************/
 /*!
 	Starting point of the application
@@ -29,7 +226,6 @@ double	 g_appTime;
 int WINAPI WinMain(HINSTANCE instanceH, HINSTANCE prevInstanceH, LPSTR command_line, int show)
 {
 	UNREFERENCED_PARAMETER(prevInstanceH);
-	UNREFERENCED_PARAMETER(command_line);
 
 	//// Enable run-time memory check for debug builds.
 	#if defined(DEBUG) | defined(_DEBUG)
@@ -49,6 +245,13 @@ int WINAPI WinMain(HINSTANCE instanceH, HINSTANCE prevInstanceH, LPSTR command_l
 	//set background color
 	AEGfxSetBackgroundColor(0.0f, 0.0f, 0.0f);
 
+	// developer tools run in the engine's console instead of the game
+	if (RunCommandLineTool(command_line))
+	{
+		AESysExit();
+		return 0;
+	}
+
 
 
 	GameStateMgrInit(GS_ASTEROIDS);
@@ -0,0 +1,143 @@
+// MatchLog.cpp
+#include "MatchLog.h"
+#include <cstring>
+#include <iostream>
+
+// =================== MatchLogWriter Implementation ===================
+
+MatchLogWriter::MatchLogWriter() : file(nullptr) {
+}
+
+MatchLogWriter::~MatchLogWriter() {
+    Close();
+}
+
+bool MatchLogWriter::Open(const std::string& path, const MatchLogFileHeader& header) {
+    if (file) {
+        return false;
+    }
+
+    if (fopen_s(&file, path.c_str(), "wb") != 0 || !file) {
+        std::cerr << "Failed to open match log " << path << std::endl;
+        file = nullptr;
+        return false;
+    }
+
+    buffer.clear();
+    buffer.reserve(FLUSH_THRESHOLD + 16);
+    Append(&header, sizeof(header));
+    return true;
+}
+
+void MatchLogWriter::Close() {
+    if (file) {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void MatchLogWriter::WriteEvent(MatchLogRecord kind, uint8_t clientID) {
+    uint8_t record[2] = { static_cast<uint8_t>(kind), clientID };
+    Append(record, sizeof(record));
+}
+
+void MatchLogWriter::WriteInput(uint8_t clientID, uint8_t buttons) {
+    uint8_t record[3] = { static_cast<uint8_t>(MatchLogRecord::INPUT), clientID, buttons };
+    Append(record, sizeof(record));
+}
+
+void MatchLogWriter::WriteTick() {
+    uint8_t record = static_cast<uint8_t>(MatchLogRecord::TICK);
+    Append(&record, sizeof(record));
+}
+
+void MatchLogWriter::WriteTick(uint64_t hash) {
+    uint8_t record[1 + sizeof(hash)];
+    record[0] = static_cast<uint8_t>(MatchLogRecord::TICK_HASH);
+    memcpy(record + 1, &hash, sizeof(hash));
+    Append(record, sizeof(record));
+}
+
+void MatchLogWriter::Append(const void* data, size_t size) {
+    if (!file) {
+        return;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + size);
+
+    if (buffer.size() >= FLUSH_THRESHOLD) {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+}
+
+// =================== MatchLogReader Implementation ===================
+
+MatchLogReader::MatchLogReader() : file(nullptr) {
+}
+
+MatchLogReader::~MatchLogReader() {
+    Close();
+}
+
+bool MatchLogReader::Open(const std::string& path) {
+    Close();
+
+    if (fopen_s(&file, path.c_str(), "rb") != 0 || !file) {
+        std::cerr << "Failed to open match log " << path << std::endl;
+        file = nullptr;
+        return false;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != MATCH_LOG_MAGIC || header.version != MATCH_LOG_VERSION) {
+        std::cerr << "Not a supported match log: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void MatchLogReader::Close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool MatchLogReader::Next(MatchLogEntry& entry) {
+    if (!file) {
+        return false;
+    }
+
+    uint8_t kind;
+    if (fread(&kind, 1, 1, file) != 1) {
+        return false;
+    }
+
+    entry.kind = static_cast<MatchLogRecord>(kind);
+    entry.clientID = 0;
+    entry.buttons = 0;
+    entry.hash = 0;
+
+    switch (entry.kind) {
+    case MatchLogRecord::JOIN:
+    case MatchLogRecord::LEAVE:
+        return fread(&entry.clientID, 1, 1, file) == 1;
+
+    case MatchLogRecord::INPUT:
+        return fread(&entry.clientID, 1, 1, file) == 1 && fread(&entry.buttons, 1, 1, file) == 1;
+
+    case MatchLogRecord::TICK:
+        return true;
+
+    case MatchLogRecord::TICK_HASH:
+        return fread(&entry.hash, sizeof(entry.hash), 1, file) == 1;
+    }
+
+    return false;
+}
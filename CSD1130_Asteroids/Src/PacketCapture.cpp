@@ -0,0 +1,150 @@
+// PacketCapture.cpp
+#include "PacketCapture.h"
+#include <cstring>
+#include <iostream>
+
+// =================== PacketCaptureWriter Implementation ===================
+
+PacketCaptureWriter::PacketCaptureWriter() : file(nullptr), isOpen(false), droppedRecords(0) {
+}
+
+PacketCaptureWriter::~PacketCaptureWriter() {
+    Close();
+}
+
+bool PacketCaptureWriter::Open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    if (file) {
+        return false;
+    }
+
+    if (fopen_s(&file, path.c_str(), "wb") != 0 || !file) {
+        std::cerr << "Failed to open capture file " << path << std::endl;
+        file = nullptr;
+        return false;
+    }
+
+    buffer.clear();
+    buffer.reserve(FLUSH_THRESHOLD + sizeof(CaptureRecordHeader) + UINT16_MAX);
+
+    CaptureFileHeader header;
+    buffer.insert(buffer.end(), reinterpret_cast<const char*>(&header),
+        reinterpret_cast<const char*>(&header) + sizeof(header));
+
+    startTime = std::chrono::steady_clock::now();
+    droppedRecords = 0;
+    isOpen = true;
+    return true;
+}
+
+void PacketCaptureWriter::Close() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    if (file) {
+        isOpen = false;
+        FlushLocked();
+        fclose(file);
+        file = nullptr;
+
+        if (droppedRecords > 0) {
+            std::cerr << "Capture left out " << droppedRecords << " datagrams larger than "
+                << UINT16_MAX << " bytes" << std::endl;
+        }
+    }
+}
+
+void PacketCaptureWriter::Write(CaptureDirection direction, uint32_t address, uint16_t port,
+    uint8_t clientID, const void* data, size_t size) {
+    auto now = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+
+    if (!file) {
+        return;
+    }
+    if (size > UINT16_MAX) {
+        droppedRecords++;
+        return;
+    }
+
+    CaptureRecordHeader record;
+    record.timestampUs = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(now - startTime).count());
+    record.address = address;
+    record.port = port;
+    record.clientID = clientID;
+    record.direction = direction;
+    record.size = static_cast<uint16_t>(size);
+
+    size_t offset = buffer.size();
+    buffer.resize(offset + sizeof(record) + size);
+    memcpy(buffer.data() + offset, &record, sizeof(record));
+    if (size > 0) {
+        memcpy(buffer.data() + offset + sizeof(record), data, size);
+    }
+
+    if (buffer.size() >= FLUSH_THRESHOLD) {
+        FlushLocked();
+    }
+}
+
+void PacketCaptureWriter::FlushLocked() {
+    if (file && !buffer.empty()) {
+        fwrite(buffer.data(), 1, buffer.size(), file);
+        buffer.clear();
+    }
+}
+
+// =================== PacketCaptureReader Implementation ===================
+
+PacketCaptureReader::PacketCaptureReader() : file(nullptr) {
+}
+
+PacketCaptureReader::~PacketCaptureReader() {
+    Close();
+}
+
+bool PacketCaptureReader::Open(const std::string& path) {
+    Close();
+
+    if (fopen_s(&file, path.c_str(), "rb") != 0 || !file) {
+        std::cerr << "Failed to open capture file " << path << std::endl;
+        file = nullptr;
+        return false;
+    }
+
+    CaptureFileHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION) {
+        std::cerr << "Not a supported capture file: " << path << std::endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void PacketCaptureReader::Close() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+bool PacketCaptureReader::Next(CaptureRecordHeader& header, std::vector<char>& payload) {
+    if (!file) {
+        return false;
+    }
+
+    if (fread(&header, sizeof(header), 1, file) != 1) {
+        return false;
+    }
+
+    payload.resize(header.size);
+    if (header.size > 0 && fread(payload.data(), 1, header.size, file) != header.size) {
+        return false;
+    }
+
+    return true;
+}
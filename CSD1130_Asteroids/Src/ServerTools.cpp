@@ -0,0 +1,579 @@
+// ServerTools.cpp
+#include "ServerTools.h"
+// GameServer.h pulls in winsock2.h, which must come before the windows.h included by AEEngine.h
+#include "GameServer.h"
+#include "SpatialHash.h"
+#include "EntityStore.h"
+#include "MatchRandom.h"
+#include "NetworkProtocol.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const float TICK_DT = 1.0f / SIMULATION_TICK_RATE;
+
+// Each measurement repeats its step for about this long and reports the mean
+const double MEASURE_BUDGET_US = 250000.0;
+
+// Mean microseconds per call of step, which returns a result kept in result
+template <typename Step>
+double MeasureUs(Step step, unsigned int& result) {
+    unsigned int calls = 0;
+    double elapsed = 0.0;
+    Clock::time_point start = Clock::now();
+    do {
+        result = step();
+        calls++;
+        elapsed = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    } while (elapsed < MEASURE_BUDGET_US);
+    return elapsed / calls;
+}
+
+AABB CenteredBox(float x, float y, float width, float height) {
+    AABB box;
+    box.min.x = x - width * 0.5f;
+    box.min.y = y - height * 0.5f;
+    box.max.x = x + width * 0.5f;
+    box.max.y = y + height * 0.5f;
+    return box;
+}
+
+// Box covering an object over the next dt, like the server's broadphase input
+AABB SweptBox(const AABB& box, const AEVec2& vel, float dt) {
+    AABB swept = box;
+    float dx = vel.x * dt;
+    float dy = vel.y * dt;
+    (dx < 0.0f ? swept.min.x : swept.max.x) += dx;
+    (dy < 0.0f ? swept.min.y : swept.max.y) += dy;
+    return swept;
+}
+
+AABB OffsetBox(const AABB& box, const AEVec2& offset) {
+    AABB moved;
+    moved.min.x = box.min.x + offset.x;
+    moved.min.y = box.min.y + offset.y;
+    moved.max.x = box.max.x + offset.x;
+    moved.max.y = box.max.y + offset.y;
+    return moved;
+}
+
+// Coordinate for the batch check: often snapped to a coarse grid so edges touch exactly,
+// now and then a value the comparisons and min / max treat specially
+float CheckCoordinate(MatchRandom& random, float low, float high) {
+    switch (random.Below(32)) {
+    case 0:
+        return -0.0f;
+    case 1:
+        return std::numeric_limits<float>::infinity();
+    case 2:
+        return -std::numeric_limits<float>::infinity();
+    case 3:
+        return std::numeric_limits<float>::quiet_NaN();
+    case 4:
+        return std::numeric_limits<float>::denorm_min();
+    default:
+        break;
+    }
+
+    float value = random.Range(low, high);
+    return random.Below(4) == 0 ? std::floor(value / 10.0f) * 10.0f : value;
+}
+
+AABB CheckBox(MatchRandom& random) {
+    AABB box;
+    box.min.x = CheckCoordinate(random, -100.0f, 100.0f);
+    box.min.y = CheckCoordinate(random, -100.0f, 100.0f);
+    box.max.x = box.min.x + random.Range(0.0f, 60.0f);
+    box.max.y = box.min.y + random.Range(0.0f, 60.0f);
+    return box;
+}
+
+#ifndef SIM_FIXED_POINT
+// Moving entities of the server types 0 to 2 (ship, bullet, asteroid) spread over the
+// world. Some sit at -0 or on the wrap edge, where adding a zero or a wrong compare would
+// change the bits.
+void FillEntities(EntityStore& store, uint32_t count, const AABB& world, MatchRandom& random) {
+    for (uint32_t i = 0; i < count; i++) {
+        AEVec2 pos, vel, scale;
+        AEVec2Set(&pos, random.Range(world.min.x, world.max.x), random.Range(world.min.y, world.max.y));
+        AEVec2Set(&vel, random.Range(-400.0f, 400.0f), random.Range(-400.0f, 400.0f));
+        AEVec2Set(&scale, random.Range(3.0f, 90.0f), random.Range(3.0f, 90.0f));
+        if (i % 97 == 0) {
+            pos.x = -0.0f;
+            vel.x = 0.0f;
+        }
+        if (i % 89 == 0) {
+            pos.x = world.max.x;
+            vel.x = 0.001f;
+        }
+        store.Create(static_cast<uint8_t>(i % 3), scale, pos, vel, 0.0f);
+    }
+}
+
+// The per entity loop GameServer::UpdateGameState ran before EntityStore::Integrate
+void IntegrateLoop(EntityStore& store, float dt, const AABB& world, uint32_t wrapTypes) {
+    const uint32_t count = store.Count();
+    for (uint32_t i = 0; i < count; i++) {
+        if (!store.active[i]) {
+            continue;
+        }
+
+        store.posPrev[i] = store.posCurr[i];
+        store.posCurr[i].x += store.velCurr[i].x * dt;
+        store.posCurr[i].y += store.velCurr[i].y * dt;
+        if ((wrapTypes >> store.type[i]) & 1u) {
+            store.posCurr[i].x = AEWrap(store.posCurr[i].x, world.min.x, world.max.x);
+            store.posCurr[i].y = AEWrap(store.posCurr[i].y, world.min.y, world.max.y);
+        }
+        store.UpdateBounds(i);
+    }
+}
+
+// Entities whose positions or box differ in any bit
+uint32_t CountDifferentEntities(const EntityStore& a, const EntityStore& b) {
+    uint32_t different = 0;
+    for (uint32_t i = 0; i < a.Count(); i++) {
+        if (std::memcmp(&a.posCurr[i], &b.posCurr[i], sizeof(a.posCurr[i])) != 0 ||
+            std::memcmp(&a.posPrev[i], &b.posPrev[i], sizeof(a.posPrev[i])) != 0 ||
+            std::memcmp(&a.boundingBox[i], &b.boundingBox[i], sizeof(a.boundingBox[i])) != 0) {
+            different++;
+        }
+    }
+    return different;
+}
+#endif
+
+} // namespace
+
+void ServerTools::RunCollisionBenchmark() {
+    // The game's entity store holds 2048 entities, so the sweep runs the steps of
+    // GameServer::CheckForCollisions on arrays of its own: the asteroids' swept boxes go into
+    // a wrapping SpatialHash, every bullet queries it with its swept box and its candidates,
+    // moved by their wrap offsets, go through CollisionIntersection_RectRectBatch.
+    // All pairs runs the same batch test against every asteroid.
+    const unsigned int ENTITY_COUNTS[] = { 100, 1000, 5000, 10000, 20000, 50000 };
+    const unsigned int ALL_PAIRS_LIMIT = 20000;     // seconds per tick above this
+
+    std::printf("Collision time per tick, half asteroids and half bullets at constant density\n");
+    std::printf("  entities   grid (ms)   all pairs (ms)   hits\n");
+
+    for (unsigned int count : ENTITY_COUNTS) {
+        MatchRandom random(count);
+        const unsigned int asteroidCount = count / 2;
+        const unsigned int bulletCount = count - asteroidCount;
+
+        // 40 x 40 units per entity. Everything starts 100 units inside the edges, so no pair
+        // touches across them and all pairs, which does not wrap, has the same hits to find.
+        const float side = std::sqrt(static_cast<float>(count)) * 40.0f + 200.0f;
+        AABB world = CenteredBox(0.0f, 0.0f, side, side);
+        const float inner = side * 0.5f - 100.0f;
+
+        std::vector<AABB> asteroidBoxes(asteroidCount), bulletBoxes(bulletCount);
+        std::vector<AEVec2> asteroidVelocities(asteroidCount), bulletVelocities(bulletCount);
+        for (unsigned int i = 0; i < asteroidCount; i++) {
+            float scale = random.Range(10.0f, 90.0f);
+            asteroidBoxes[i] = CenteredBox(random.Range(-inner, inner), random.Range(-inner, inner), scale, scale);
+            asteroidVelocities[i].x = random.Range(-60.0f, 60.0f);
+            asteroidVelocities[i].y = random.Range(-60.0f, 60.0f);
+        }
+        for (unsigned int i = 0; i < bulletCount; i++) {
+            float angle = random.Range(-PI, PI);
+            bulletBoxes[i] = CenteredBox(random.Range(-inner, inner), random.Range(-inner, inner), 20.0f, 3.0f);
+            bulletVelocities[i].x = cosf(angle) * 400.0f;
+            bulletVelocities[i].y = sinf(angle) * 400.0f;
+        }
+
+        SpatialHash grid(60.0f);
+        grid.SetWorld(world);
+        std::vector<AABB> candidateBoxes;
+        std::vector<AEVec2> candidateVelocities;
+        std::vector<unsigned int> hitIndices(asteroidCount);
+        std::vector<float> hitTimes(asteroidCount);
+
+        unsigned int gridHits = 0;
+        double gridUs = MeasureUs([&]() {
+            grid.Clear();
+            for (unsigned int i = 0; i < asteroidCount; i++) {
+                grid.Insert(i, SweptBox(asteroidBoxes[i], asteroidVelocities[i], TICK_DT));
+            }
+            grid.Build();
+
+            unsigned int hits = 0;
+            for (unsigned int b = 0; b < bulletCount; b++) {
+                candidateBoxes.clear();
+                candidateVelocities.clear();
+                grid.Query(SweptBox(bulletBoxes[b], bulletVelocities[b], TICK_DT), [&](uint32_t a, const AEVec2& offset) {
+                    candidateBoxes.push_back(OffsetBox(asteroidBoxes[a], offset));
+                    candidateVelocities.push_back(asteroidVelocities[a]);
+                    return true;
+                });
+                hits += CollisionIntersection_RectRectBatch(bulletBoxes[b], bulletVelocities[b], candidateBoxes.data(),
+                    candidateVelocities.data(), static_cast<unsigned int>(candidateBoxes.size()), TICK_DT,
+                    hitIndices.data(), hitTimes.data());
+            }
+            return hits;
+        }, gridHits);
+
+        if (count > ALL_PAIRS_LIMIT) {
+            std::printf("  %8u   %9.3f   %14s   %u\n", count, gridUs / 1000.0, "-", gridHits);
+            continue;
+        }
+
+        unsigned int allPairsHits = 0;
+        double allPairsUs = MeasureUs([&]() {
+            unsigned int hits = 0;
+            for (unsigned int b = 0; b < bulletCount; b++) {
+                hits += CollisionIntersection_RectRectBatch(bulletBoxes[b], bulletVelocities[b], asteroidBoxes.data(),
+                    asteroidVelocities.data(), asteroidCount, TICK_DT, hitIndices.data(), hitTimes.data());
+            }
+            return hits;
+        }, allPairsHits);
+
+        std::printf("  %8u   %9.3f   %14.3f   %u%s\n", count, gridUs / 1000.0, allPairsUs / 1000.0, gridHits,
+            gridHits == allPairsHits ? "" : " (all pairs found a different number)");
+    }
+}
+
+bool ServerTools::RunIntegrateBenchmark() {
+#ifdef SIM_FIXED_POINT
+    std::printf("Fixed point builds integrate with the scalar loop only, there is nothing to compare\n");
+    return true;
+#else
+    // World and wrapped types of the server: ships and asteroids wrap, bullets do not
+    AABB world;
+    AEVec2Set(&world.min, WORLD_MIN_X, WORLD_MIN_Y);
+    AEVec2Set(&world.max, WORLD_MAX_X, WORLD_MAX_Y);
+    const uint32_t wrapTypes = (1u << 0) | (1u << 2);
+
+    // An odd count so the kernel's scalar tail runs too
+    const uint32_t CHECK_ENTITIES = 4097;
+    const unsigned int CHECK_TICKS = 600;
+
+    EntityStore kernel(CHECK_ENTITIES), loop(CHECK_ENTITIES);
+    MatchRandom kernelRandom(1), loopRandom(1);
+    FillEntities(kernel, CHECK_ENTITIES, world, kernelRandom);
+    FillEntities(loop, CHECK_ENTITIES, world, loopRandom);
+
+    uint32_t different = 0;
+    unsigned int firstDifferentTick = 0;
+    for (unsigned int tick = 0; tick < CHECK_TICKS && different == 0; tick++) {
+        kernel.Integrate(TICK_DT, world, wrapTypes);
+        IntegrateLoop(loop, TICK_DT, world, wrapTypes);
+        different = CountDifferentEntities(kernel, loop);
+        firstDifferentTick = tick;
+    }
+
+    std::printf("Integrate against the per entity loop, %u ticks over %u entities: ", CHECK_TICKS, CHECK_ENTITIES);
+    if (different != 0) {
+        std::printf("%u entities differ after tick %u\n", different, firstDifferentTick);
+    }
+    else {
+        std::printf("bit identical\n");
+    }
+
+    // Handles hold a 16 bit slot, larger counts are split over several stores
+    const uint32_t BENCH_COUNTS[] = { 2048, 100000 };
+    const uint32_t STORE_LIMIT = 50000;
+
+    std::printf("Integration pass over every entity\n");
+    std::printf("  entities   loop (us)   Integrate (us)\n");
+    for (uint32_t count : BENCH_COUNTS) {
+        std::vector<std::unique_ptr<EntityStore>> kernelStores, loopStores;
+        MatchRandom random(count);
+        for (uint32_t filled = 0; filled < count; filled += STORE_LIMIT) {
+            uint32_t storeCount = (std::min)(count - filled, STORE_LIMIT);
+            kernelStores.emplace_back(new EntityStore(storeCount));
+            loopStores.emplace_back(new EntityStore(storeCount));
+            MatchRandom copy = random;
+            FillEntities(*kernelStores.back(), storeCount, world, random);
+            FillEntities(*loopStores.back(), storeCount, world, copy);
+        }
+
+        unsigned int unused = 0;
+        double loopUs = MeasureUs([&]() {
+            for (auto& store : loopStores) {
+                IntegrateLoop(*store, TICK_DT, world, wrapTypes);
+            }
+            return 0u;
+        }, unused);
+        double kernelUs = MeasureUs([&]() {
+            for (auto& store : kernelStores) {
+                store->Integrate(TICK_DT, world, wrapTypes);
+            }
+            return 0u;
+        }, unused);
+
+        std::printf("  %8u   %9.1f   %14.1f\n", count, loopUs, kernelUs);
+    }
+
+    return different == 0;
+#endif
+}
+
+bool ServerTools::RunSweptBatchCheck() {
+    // Time steps of the server tick, a slow client frame and a stall
+    const float TIME_STEPS[] = { 1.0f / 60.0f, 1.0f / 20.0f, 0.25f };
+    const unsigned int ROUNDS = 20000;
+    const unsigned int MAX_CANDIDATES = 67;     // several SIMD blocks and every tail length
+
+    MatchRandom random(1);
+    std::vector<AABB> boxes(MAX_CANDIDATES);
+    std::vector<AEVec2> velocities(MAX_CANDIDATES);
+    std::vector<unsigned int> hitIndices(MAX_CANDIDATES);
+    std::vector<float> hitTimes(MAX_CANDIDATES);
+
+    uint64_t pairs = 0, hits = 0, mismatches = 0;
+    for (unsigned int round = 0; round < ROUNDS; round++) {
+        const float dt = TIME_STEPS[round % 3];
+        unsigned int count = 1 + random.Below(MAX_CANDIDATES);
+
+        AABB box = CheckBox(random);
+        AEVec2 vel;
+        vel.x = random.Below(5) == 0 ? 0.0f : CheckCoordinate(random, -600.0f, 600.0f);
+        vel.y = random.Below(5) == 0 ? 0.0f : CheckCoordinate(random, -600.0f, 600.0f);
+
+        // Some candidates move with the box on an axis, so their relative velocity is 0
+        for (unsigned int i = 0; i < count; i++) {
+            boxes[i] = CheckBox(random);
+            velocities[i].x = random.Below(5) == 0 ? vel.x : CheckCoordinate(random, -600.0f, 600.0f);
+            velocities[i].y = random.Below(5) == 0 ? vel.y : CheckCoordinate(random, -600.0f, 600.0f);
+        }
+
+        unsigned int batchHits = CollisionIntersection_RectRectBatch(box, vel, boxes.data(), velocities.data(), count,
+            dt, hitIndices.data(), hitTimes.data());
+
+        unsigned int scalarHits = 0;
+        for (unsigned int i = 0; i < count; i++) {
+            float time = 0.0f;
+            if (!CollisionIntersection_RectRect(box, vel, boxes[i], velocities[i], dt, time)) {
+                continue;
+            }
+            if (scalarHits >= batchHits || hitIndices[scalarHits] != i ||
+                std::memcmp(&hitTimes[scalarHits], &time, sizeof(time)) != 0) {
+                mismatches++;
+            }
+            scalarHits++;
+        }
+        if (scalarHits != batchHits) {
+            mismatches++;
+        }
+
+        pairs += count;
+        hits += scalarHits;
+    }
+
+    std::printf("Batched swept AABB test against the scalar test: %llu pairs, %llu hits, %llu mismatches\n",
+        static_cast<unsigned long long>(pairs), static_cast<unsigned long long>(hits),
+        static_cast<unsigned long long>(mismatches));
+    return mismatches == 0;
+}
+
+void ServerTools::RunShapePairBenchmark() {
+    const unsigned int CANDIDATES = 4096;
+    const float MISS_OFFSET = 400.0f;           // moves every candidate out of reach of the query
+
+    // Asteroids spread over the cells around the query, as the grid hands them out
+    MatchRandom random(5);
+    std::vector<AABB> boxes(CANDIDATES);
+    std::vector<AEVec2> velocities(CANDIDATES), centers(CANDIDATES);
+    std::vector<float> radii(CANDIDATES);
+    for (unsigned int i = 0; i < CANDIDATES; i++) {
+        float scale = random.Range(10.0f, 90.0f);
+        centers[i].x = random.Range(-60.0f, 60.0f);
+        centers[i].y = random.Range(-60.0f, 60.0f);
+        radii[i] = scale * 0.5f;
+        boxes[i] = CenteredBox(centers[i].x, centers[i].y, scale, scale);
+        velocities[i].x = random.Range(-60.0f, 60.0f);
+        velocities[i].y = random.Range(-60.0f, 60.0f);
+    }
+
+    const AABB box = CenteredBox(0.0f, 0.0f, 40.0f, 40.0f);
+    const AEVec2 center = { 0.0f, 0.0f };
+    const AEVec2 vel = { 150.0f, 40.0f };
+    const float radius = 20.0f;
+
+    std::vector<unsigned int> hitIndices(CANDIDATES);
+    std::vector<float> hitTimes(CANDIDATES);
+
+    auto rectScalar = [&]() {
+        unsigned int hits = 0;
+        for (unsigned int i = 0; i < CANDIDATES; i++) {
+            float time = 0.0f;
+            hits += CollisionIntersection_RectRect(box, vel, boxes[i], velocities[i], TICK_DT, time) ? 1 : 0;
+        }
+        return hits;
+    };
+    auto rectBatch = [&]() {
+        return CollisionIntersection_RectRectBatch(box, vel, boxes.data(), velocities.data(), CANDIDATES,
+            TICK_DT, hitIndices.data(), hitTimes.data());
+    };
+    auto circle = [&]() {
+        unsigned int hits = 0;
+        for (unsigned int i = 0; i < CANDIDATES; i++) {
+            float time = 0.0f;
+            hits += CollisionIntersection_CircleCircle(center, radius, vel, centers[i], radii[i], velocities[i],
+                TICK_DT, time) ? 1 : 0;
+        }
+        return hits;
+    };
+
+    std::printf("Swept narrowphase tests, %u candidates per pass, dt %.4f s\n", CANDIDATES, TICK_DT);
+    std::printf("%-12s %-16s %12s %8s\n", "candidates", "test", "ns / pair", "hits");
+    for (int pass = 0; pass < 2; pass++) {
+        const char* scenario = pass == 0 ? "nearby" : "all misses";
+        unsigned int hits = 0;
+        double us = MeasureUs(rectScalar, hits);
+        std::printf("%-12s %-16s %12.2f %8u\n", scenario, "rect, scalar", us * 1000.0 / CANDIDATES, hits);
+        us = MeasureUs(rectBatch, hits);
+        std::printf("%-12s %-16s %12.2f %8u\n", scenario, "rect, batch", us * 1000.0 / CANDIDATES, hits);
+        us = MeasureUs(circle, hits);
+        std::printf("%-12s %-16s %12.2f %8u\n", scenario, "circle", us * 1000.0 / CANDIDATES, hits);
+
+        for (unsigned int i = 0; i < CANDIDATES; i++) {
+            centers[i].x += MISS_OFFSET;
+            boxes[i].min.x += MISS_OFFSET;
+            boxes[i].max.x += MISS_OFFSET;
+        }
+    }
+}
+
+bool ServerTools::RunRollbackGameEndCheck(GameServer& server, unsigned int& gameEnds) {
+    const unsigned int CHECK_WINDOW = 8;
+    const ClientID CHECK_CLIENT = 1;
+    const float ASTEROID_SCALE = 60.0f;     // the largest asteroid the server spawns
+
+    if (!StartHeadless(server)) {
+        return false;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(server.playersMutex);
+    if (!server.SetRollbackWindow(CHECK_WINDOW)) {
+        server.Shutdown();
+        return false;
+    }
+
+    // A single player, so the match ends when their ship is out of lives
+    server.OnClientConnect(CHECK_CLIENT);
+    for (int i = 0; i < 10; i++) {
+        server.Tick();
+    }
+
+    // Last life and an asteroid parked on the ship: the next tick ends the match
+    GameServer::PlayerData& player = server.players[CHECK_CLIENT];
+    player.lives = 1;
+    server.CreateAsteroid(server.entities.posCurr[server.entities.IndexOf(player.ship)],
+        MakeSimVec2(SimFromFloat(0.0f), SimFromFloat(0.0f)), ASTEROID_SCALE);
+    uint32_t endTick = server.currentTick;
+    for (unsigned int i = 0; i < CHECK_WINDOW / 2; i++) {
+        server.Tick();
+    }
+    unsigned int endsBefore = server.sentGameEnds;
+
+    // Turning in the end tick arrives late: the world is rewound across the end, which
+    // happens again in the same tick
+    PlayerInputMessage input;
+    input.clientID = CHECK_CLIENT;
+    input.left = true;
+    input.inputTick = endTick;
+    server.ProcessPlayerInput(CHECK_CLIENT, &input);
+    server.Tick();
+
+    gameEnds = server.sentGameEnds;
+    bool passed = endsBefore == 1 && server.rollbackStats.rollbacks == 1 && server.sentGameEnds == 1;
+
+    server.Shutdown();
+    return passed;
+}
+
+void ServerTools::RunStepBenchmark() {
+    const unsigned int ASTEROID_COUNTS[] = { 200, 1000 };
+    const ClientID PLAYERS = 4;
+    const unsigned int TICKS = 600;
+#ifdef SIM_FIXED_POINT
+    const char* build = "fixed point";
+#else
+    const char* build = "float";
+#endif
+
+    std::printf("Server ticks with the %s simulation, %u players, %u ticks\n", build, PLAYERS, TICKS);
+    std::printf("%10s %12s %10s\n", "asteroids", "us / tick", "entities");
+    for (unsigned int asteroidCount : ASTEROID_COUNTS) {
+        GameServer server;
+        server.SetRandomSeed(1);
+        if (!StartHeadless(server)) {
+            std::printf("Could not start a headless server\n");
+            return;
+        }
+
+        std::lock_guard<std::recursive_mutex> lock(server.playersMutex);
+        for (ClientID client = 1; client <= PLAYERS; client++) {
+            server.OnClientConnect(client);
+        }
+        server.Tick();      // starts the match
+
+        MatchRandom random(2);
+        for (unsigned int i = 0; i < asteroidCount; i++) {
+            SimVec2 pos = MakeSimVec2(SimRange(random, -WORLD_VIEW_HALF_WIDTH, WORLD_VIEW_HALF_WIDTH),
+                SimRange(random, -WORLD_VIEW_HALF_HEIGHT, WORLD_VIEW_HALF_HEIGHT));
+            SimVec2 vel = MakeSimVec2(SimRange(random, -60.0f, 60.0f), SimRange(random, -60.0f, 60.0f));
+            server.CreateAsteroid(pos, vel, random.Range(10.0f, 60.0f));
+        }
+
+        double elapsedUs = 0.0;
+        for (unsigned int tick = 0; tick < TICKS; tick++) {
+            // Every ship turns, thrusts and fires in its own rhythm and never runs out of
+            // lives, so the match runs through
+            for (ClientID client = 1; client <= PLAYERS; client++) {
+                server.players[client].lives = GameServer::INITIAL_LIVES;
+
+                PlayerInputMessage input;
+                input.clientID = client;
+                input.up = (tick / 30 + client) % 2 == 0;
+                input.left = (tick / 45 + client) % 3 == 0;
+                input.fire = (tick + client * 7) % 20 < 10;
+                server.ProcessPlayerInput(client, &input);
+            }
+
+            Clock::time_point start = Clock::now();
+            server.Tick();
+            elapsedUs += std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        }
+
+        std::printf("%10u %12.1f %10u\n", asteroidCount, elapsedUs / TICKS, server.entities.Count());
+        server.Shutdown();
+    }
+}
+
+bool ServerTools::StartHeadless(GameServer& server) {
+    // No socket, the messages are only counted
+    if (!server.server.InitializeReplay()) {
+        return false;
+    }
+
+    std::lock_guard<std::recursive_mutex> lock(server.playersMutex);
+    {
+        std::lock_guard<std::recursive_mutex> lockObjects(server.gameObjectsMutex);
+        server.players.clear();
+        server.asteroids.clear();
+        server.entities.Clear();
+    }
+
+    server.isRunning = true;
+    server.gameInProgress = false;
+    server.tickAccumulator = 0.0f;
+    server.currentTick = 0;
+    server.gameEndTimer = 0.0f;
+    server.announcedEndMatch = 0;
+    server.sentGameEnds = 0;
+    server.rollbackStats = RollbackStats();
+    return true;
+}
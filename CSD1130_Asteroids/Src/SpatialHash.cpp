@@ -0,0 +1,120 @@
+// SpatialHash.cpp
+#include "SpatialHash.h"
+
+SpatialHash::SpatialHash(float cellSize) : invCellSize(1.0f / cellSize), wrap(false), bucketMask(0),
+queryStamp(0) {
+    world.min.x = world.min.y = world.max.x = world.max.y = 0.0f;
+    overhang = world;
+}
+
+void SpatialHash::SetCellSize(float size) {
+    invCellSize = 1.0f / size;
+}
+
+void SpatialHash::SetWorld(const AABB& bounds) {
+    world = bounds;
+    wrap = true;
+}
+
+void SpatialHash::Clear() {
+    overhang.min.x = overhang.min.y = overhang.max.x = overhang.max.y = 0.0f;
+    items.clear();
+    oversized.clear();
+    cellItems.clear();
+}
+
+int SpatialHash::WrapShifts(const AABB& box, AEVec2 shifts[MAX_WRAP_SHIFTS]) const {
+    shifts[0].x = shifts[0].y = 0.0f;
+    if (!wrap) {
+        return 1;
+    }
+
+    // A copy of the box one world size to the left reaches the boxes hanging over the
+    // left edge if the box comes within their overhang of the right edge, and so on
+    float width = world.max.x - world.min.x;
+    float height = world.max.y - world.min.y;
+
+    float shiftsX[3] = { 0.0f }, shiftsY[3] = { 0.0f };
+    int countX = 1, countY = 1;
+    if (box.max.x > world.max.x - overhang.min.x) shiftsX[countX++] = -width;
+    if (box.min.x < world.min.x + overhang.max.x) shiftsX[countX++] = width;
+    if (box.max.y > world.max.y - overhang.min.y) shiftsY[countY++] = -height;
+    if (box.min.y < world.min.y + overhang.max.y) shiftsY[countY++] = height;
+
+    int count = 0;
+    for (int y = 0; y < countY; y++) {
+        for (int x = 0; x < countX; x++) {
+            shifts[count].x = shiftsX[x];
+            shifts[count].y = shiftsY[y];
+            count++;
+        }
+    }
+    return count;
+}
+
+void SpatialHash::Insert(uint32_t handle, const AABB& box) {
+    Item item;
+    item.handle = handle;
+    item.minX = CellCoord(box.min.x);
+    item.minY = CellCoord(box.min.y);
+    item.maxX = CellCoord(box.max.x);
+    item.maxY = CellCoord(box.max.y);
+
+    if (wrap) {
+        overhang.min.x = (std::max)(overhang.min.x, world.min.x - box.min.x);
+        overhang.min.y = (std::max)(overhang.min.y, world.min.y - box.min.y);
+        overhang.max.x = (std::max)(overhang.max.x, box.max.x - world.max.x);
+        overhang.max.y = (std::max)(overhang.max.y, box.max.y - world.max.y);
+    }
+
+    if (item.maxX - item.minX >= MAX_CELL_SPAN || item.maxY - item.minY >= MAX_CELL_SPAN) {
+        oversized.push_back(item);
+    }
+    else {
+        items.push_back(item);
+    }
+}
+
+void SpatialHash::Build() {
+    // Stamps of earlier ticks are all below the current query stamp
+    if (visitStamp.size() < items.size()) {
+        visitStamp.resize(items.size(), 0u);
+    }
+
+    size_t cellRefs = 0;
+    for (const Item& item : items) {
+        cellRefs += static_cast<size_t>(item.maxX - item.minX + 1) * static_cast<size_t>(item.maxY - item.minY + 1);
+    }
+
+    // About two buckets per cell reference keeps unrelated cells mostly apart
+    uint32_t bucketCount = 64;
+    while (bucketCount < cellRefs * 2) {
+        bucketCount <<= 1;
+    }
+    bucketMask = bucketCount - 1;
+
+    // Counting sort: count per bucket, prefix sum, then scatter
+    bucketStart.assign(bucketCount + 1, 0u);
+    for (const Item& item : items) {
+        for (int32_t y = item.minY; y <= item.maxY; y++) {
+            for (int32_t x = item.minX; x <= item.maxX; x++) {
+                bucketStart[Bucket(x, y) + 1]++;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        bucketStart[i + 1] += bucketStart[i];
+    }
+
+    cellItems.resize(cellRefs);
+    scatterCursor.assign(bucketStart.begin(), bucketStart.end() - 1);
+    for (uint32_t index = 0; index < items.size(); index++) {
+        const Item& item = items[index];
+        for (int32_t y = item.minY; y <= item.maxY; y++) {
+            for (int32_t x = item.minX; x <= item.maxX; x++) {
+                cellItems[scatterCursor[Bucket(x, y)]++] = index;
+            }
+        }
+    }
+}
@@ -2,14 +2,40 @@
 #include "UDPNetwork.h"
 #include <iostream>
 #include <chrono>
+#include <algorithm>
 
 // =================== UDPServer Implementation ===================
 
-UDPServer::UDPServer() : socket(INVALID_SOCKET), isRunning(false), nextClientID(1) {
+UDPServer::UDPServer() : socket(INVALID_SOCKET), isRunning(false), replayMode(false), nextClientID(1),
+maxClients(4), droppedPackets(0), droppedBytes(0), abuseDisconnects(0), queuedMessages(0), flushedDatagrams(0) {
     // Initialize onMessage callbacks to empty functions to avoid nullptr checks
     onClientConnect = [](ClientID) {};
     onClientDisconnect = [](ClientID) {};
     onMessage = [](ClientID, const void*, size_t) {};
+
+    dispatcher.Register<MessageType::CONNECT_REQUEST>(
+        [this](const sockaddr_in& from, ClientID, TimePoint now, const MessageView<NetworkMessage>&) {
+            HandleConnectionRequest(from, now);
+        });
+    dispatcher.Register<MessageType::DISCONNECT>(
+        [this](const sockaddr_in&, ClientID sender, TimePoint, const MessageView<NetworkMessage>&) {
+            HandleDisconnectRequest(sender);
+        });
+    dispatcher.Register<MessageType::HEARTBEAT>(
+        [this](const sockaddr_in&, ClientID sender, TimePoint now, const MessageView<NetworkMessage>&) {
+            HandleHeartbeat(sender, now);
+        });
+    // Bundled messages go through the same table, the rate limit was charged for the whole datagram
+    dispatcher.Register<MessageType::BUNDLE>(
+        [this](const sockaddr_in& from, ClientID sender, TimePoint now, const MessageView<BundleMessage>& bundle) {
+            ForEachBundledMessage(bundle.Data(), bundle.Size(), [&](const void* data, size_t size) {
+                dispatcher.Dispatch(from, sender, now, data, size);
+            });
+        });
+    dispatcher.SetFallback(
+        [this](const sockaddr_in&, ClientID sender, TimePoint now, const void* data, size_t size) {
+            ForwardToGame(sender, data, size, now);
+        });
 }
 
 UDPServer::~UDPServer() {
@@ -66,6 +92,18 @@ bool UDPServer::Initialize(uint16_t port) {
     return true;
 }
 
+bool UDPServer::InitializeReplay() {
+    if (isRunning) {
+        return false;
+    }
+
+    // No socket and no network thread: the replay tool drives HandleDatagram directly
+    replayMode = true;
+    replayStartTime = std::chrono::steady_clock::now();
+    isRunning = true;
+    return true;
+}
+
 void UDPServer::Shutdown() {
     if (isRunning) {
         isRunning = false;
@@ -79,12 +117,83 @@ void UDPServer::Shutdown() {
             socket = INVALID_SOCKET;
         }
 
-        WSACleanup();
+        if (!replayMode) {
+            WSACleanup();
+        }
+        replayMode = false;
+
+        StopCapture();
 
         // Clear clients
         std::lock_guard<std::mutex> lock(clientsMutex);
         clients.clear();
+        clientsByAddress.clear();
+    }
+}
+
+bool UDPServer::StartCapture(const std::string& path) {
+    if (!capture.Open(path)) {
+        return false;
+    }
+
+    std::cout << "Capturing server traffic to " << path << std::endl;
+    return true;
+}
+
+void UDPServer::StopCapture() {
+    capture.Close();
+}
+
+void UDPServer::CaptureTick(float dt) {
+    if (capture.IsOpen()) {
+        capture.Write(CaptureDirection::TICK, 0, 0, 0, &dt, sizeof(dt));
+    }
+}
+
+void UDPServer::InjectDatagram(const void* data, size_t size, const sockaddr_in& fromAddr, uint64_t timestampUs) {
+    if (!isRunning || size > MAX_PACKET_SIZE) {
+        return;
+    }
+
+    // Replays run faster than real time, so the buckets refill on the captured clock
+    TimePoint now = replayStartTime + std::chrono::microseconds(timestampUs);
+    HandleDatagram(static_cast<const char*>(data), static_cast<int>(size), fromAddr, now);
+}
+
+void UDPServer::CheckReplayTimeouts(uint64_t timestampUs) {
+    if (!isRunning || !replayMode) {
+        return;
     }
+
+    CheckClientTimeouts(replayStartTime + std::chrono::microseconds(timestampUs));
+}
+
+void UDPServer::SetRateLimit(const RateLimitConfig& config) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    rateLimit = config;
+}
+
+RateLimitConfig UDPServer::GetRateLimit() const {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    return rateLimit;
+}
+
+RateLimitStats UDPServer::GetRateLimitStats() const {
+    RateLimitStats stats;
+    stats.droppedPackets = droppedPackets.load(std::memory_order_relaxed);
+    stats.droppedBytes = droppedBytes.load(std::memory_order_relaxed);
+    stats.abuseDisconnects = abuseDisconnects.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool UDPServer::GetClientRateLimit(ClientID clientID, ClientRateLimit& out) const {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientID);
+    if (it == clients.end()) {
+        return false;
+    }
+    out = it->second.rateLimit;
+    return true;
 }
 
 void UDPServer::NetworkThread() {
@@ -95,7 +204,7 @@ void UDPServer::NetworkThread() {
         ProcessIncomingMessages();
 
         // Check for client timeouts
-        CheckClientTimeouts();
+        CheckClientTimeouts(std::chrono::steady_clock::now());
 
         // Give the CPU a break
         std::this_thread::sleep_for(std::chrono::milliseconds(1));
@@ -105,11 +214,14 @@ void UDPServer::NetworkThread() {
 }
 
 void UDPServer::ProcessIncomingMessages() {
+    // Bounded so a flood cannot keep the thread away from the timeout checks
+    constexpr int MAX_DATAGRAMS_PER_PASS = 256;
+
     char buffer[MAX_PACKET_SIZE];
     sockaddr_in clientAddr;
     int clientAddrSize = sizeof(clientAddr);
 
-    while (isRunning) {
+    for (int received = 0; isRunning && received < MAX_DATAGRAMS_PER_PASS; received++) {
         // Try to receive a message
         int bytesReceived = recvfrom(socket, buffer, MAX_PACKET_SIZE, 0,
             (sockaddr*)&clientAddr, &clientAddrSize);
@@ -126,122 +238,221 @@ void UDPServer::ProcessIncomingMessages() {
             }
         }
 
-        // Must receive at least the header
-        if (bytesReceived < sizeof(NetworkMessage)) {
-            continue;
-        }
+        HandleDatagram(buffer, bytesReceived, clientAddr, std::chrono::steady_clock::now());
+    }
+}
 
-        // Get message type
-        NetworkMessage* header = reinterpret_cast<NetworkMessage*>(buffer);
-
-        // Handle message based on type
-        switch (header->type) {
-        case MessageType::CONNECT_REQUEST:
-            HandleConnectionRequest(clientAddr);
-            break;
-
-        case MessageType::DISCONNECT:
-        {
-            // Find the client and disconnect them
-            std::lock_guard<std::mutex> lock(clientsMutex);
-            for (auto& pair : clients) {
-                if (pair.second.address.sin_addr.s_addr == clientAddr.sin_addr.s_addr &&
-                    pair.second.address.sin_port == clientAddr.sin_port) {
-                    pair.second.active = false;
-                    onClientDisconnect(pair.first);
-                    std::cout << "Client " << (int)pair.first << " disconnected" << std::endl;
-                    break;
-                }
-            }
-            break;
+void UDPServer::HandleDatagram(const char* buffer, int bytesReceived, const sockaddr_in& clientAddr,
+    TimePoint now) {
+    size_t size = static_cast<size_t>(bytesReceived);
+
+    // Resolve the sender once; the handlers below work on the ID
+    ClientID senderID;
+    bool admitted = true;
+    bool abusive = false;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        senderID = FindClientByAddress(clientAddr);
+        if (senderID != 0) {
+            admitted = AdmitPacket(clients[senderID], size, now, abusive);
         }
+    }
 
-        case MessageType::HEARTBEAT:
-        {
-            // Update client heartbeat time
-            std::lock_guard<std::mutex> lock(clientsMutex);
-            for (auto& pair : clients) {
-                if (pair.second.address.sin_addr.s_addr == clientAddr.sin_addr.s_addr &&
-                    pair.second.address.sin_port == clientAddr.sin_port) {
-                    pair.second.lastHeartbeatTime = std::chrono::steady_clock::now();
-                    break;
-                }
-            }
-            break;
+    // Dropped datagrams are still captured, replays apply the same limits
+    if (capture.IsOpen()) {
+        capture.Write(CaptureDirection::INBOUND, clientAddr.sin_addr.s_addr, clientAddr.sin_port,
+            senderID, buffer, size);
+    }
+
+    if (abusive) {
+        DisconnectAbusiveClient(senderID);
+        return;
+    }
+
+    if (admitted) {
+        dispatcher.Dispatch(clientAddr, senderID, now, buffer, size);
+    }
+}
+
+bool UDPServer::AdmitPacket(ClientConnection& client, size_t size, TimePoint now, bool& abusive) {
+    abusive = false;
+    if (!rateLimit.enabled) {
+        return true;
+    }
+
+    ClientRateLimit& limit = client.rateLimit;
+
+    // Refill both buckets for the time since the last packet
+    float elapsed = std::chrono::duration<float>(now - limit.lastRefill).count();
+    if (elapsed > 0.0f) {
+        limit.packetTokens = (std::min)(limit.packetTokens + elapsed * rateLimit.packetsPerSecond,
+            rateLimit.packetBurst);
+        limit.byteTokens = (std::min)(limit.byteTokens + elapsed * rateLimit.bytesPerSecond,
+            rateLimit.byteBurst);
+        limit.lastRefill = now;
+    }
+
+    float bytes = static_cast<float>(size);
+    if (limit.packetTokens >= 1.0f && limit.byteTokens >= bytes) {
+        limit.packetTokens -= 1.0f;
+        limit.byteTokens -= bytes;
+        return true;
+    }
+
+    limit.droppedPackets++;
+    limit.droppedBytes += size;
+    droppedPackets.fetch_add(1, std::memory_order_relaxed);
+    droppedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    // Count drops per one second window to spot clients that never back off
+    if (now - limit.windowStart > std::chrono::seconds(1)) {
+        limit.windowStart = now;
+        limit.windowDrops = 0;
+    }
+    limit.windowDrops++;
+
+    abusive = rateLimit.disconnectAbusive && limit.windowDrops >= rateLimit.abuseDropsPerSecond;
+    return false;
+}
+
+void UDPServer::DisconnectAbusiveClient(ClientID clientID) {
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        auto it = clients.find(clientID);
+        if (it == clients.end() || !it->second.active) {
+            return;
         }
+        DeactivateLocked(it->second);
 
-        default:
-        {
-            // Find client ID and call message handler
-            ClientID senderID = 0;
-            bool found = false;
-
-            {
-                std::lock_guard<std::mutex> lock(clientsMutex);
-                for (auto& pair : clients) {
-                    if (pair.second.address.sin_addr.s_addr == clientAddr.sin_addr.s_addr &&
-                        pair.second.address.sin_port == clientAddr.sin_port && pair.second.active) {
-                        senderID = pair.first;
-                        found = true;
-
-                        // Update heartbeat time
-                        pair.second.lastHeartbeatTime = std::chrono::steady_clock::now();
-
-                        break;
-                    }
-                }
-            }
+        NetworkMessage message(MessageType::DISCONNECT, 0, 0);
+        SendRaw(it->second.address, clientID, &message, sizeof(message));
+    }
 
-            if (found) {
-                onMessage(senderID, buffer, bytesReceived);
-            }
-            break;
+    abuseDisconnects.fetch_add(1, std::memory_order_relaxed);
+    onClientDisconnect(clientID);
+    std::cout << "Client " << (int)clientID << " disconnected for exceeding the rate limit" << std::endl;
+}
+
+void UDPServer::HandleDisconnectRequest(ClientID senderID) {
+    if (senderID == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        auto it = clients.find(senderID);
+        if (it == clients.end() || !it->second.active) {
+            return;
         }
+        DeactivateLocked(it->second);
+    }
+
+    // Callbacks run outside the lock, they query the client list themselves
+    onClientDisconnect(senderID);
+    std::cout << "Client " << (int)senderID << " disconnected" << std::endl;
+}
+
+void UDPServer::HandleHeartbeat(ClientID senderID, TimePoint now) {
+    // Update client heartbeat time
+    if (senderID == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(senderID);
+    if (it != clients.end()) {
+        it->second.lastHeartbeatTime = now;
+    }
+}
+
+void UDPServer::ForwardToGame(ClientID senderID, const void* data, size_t size, TimePoint now) {
+    if (senderID == 0) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        auto it = clients.find(senderID);
+        if (it == clients.end()) {
+            return;
         }
+        // Update heartbeat time
+        it->second.lastHeartbeatTime = now;
     }
+
+    onMessage(senderID, data, size);
+}
+
+ClientID UDPServer::FindClientByAddress(const sockaddr_in& addr) const {
+    auto it = clientsByAddress.find(AddressKey(addr));
+    return it != clientsByAddress.end() ? it->second : 0;
+}
+
+void UDPServer::DeactivateLocked(ClientConnection& client) {
+    client.active = false;
+    clientsByAddress.erase(AddressKey(client.address));
+}
+
+bool UDPServer::SendRaw(const sockaddr_in& addr, ClientID clientID, const void* data, size_t size) {
+    if (capture.IsOpen()) {
+        capture.Write(CaptureDirection::OUTBOUND, addr.sin_addr.s_addr, addr.sin_port,
+            clientID, data, size);
+    }
+
+    // Replays have no socket, the outgoing traffic is only measured
+    if (replayMode) {
+        return true;
+    }
+
+    int result = sendto(socket, reinterpret_cast<const char*>(data), static_cast<int>(size), 0,
+        (const sockaddr*)&addr, sizeof(addr));
+    return result != SOCKET_ERROR;
 }
 
-bool UDPServer::HandleConnectionRequest(const sockaddr_in& clientAddr) {
+bool UDPServer::HandleConnectionRequest(const sockaddr_in& clientAddr, TimePoint now) {
+    ClientID newID;
+
     // Check if this client is already connected
     {
         std::lock_guard<std::mutex> lock(clientsMutex);
-        for (auto& pair : clients) {
-            if (pair.second.address.sin_addr.s_addr == clientAddr.sin_addr.s_addr &&
-                pair.second.address.sin_port == clientAddr.sin_port && pair.second.active) {
-                // Client already connected, resend the accept message
-                ConnectAcceptMessage response;
-                response.clientID = 0; // Server ID
-                response.sequence = 0;
-                response.assignedID = pair.first;
-                response.totalPlayers = static_cast<uint8_t>(clients.size());
-
-                sendto(socket, reinterpret_cast<const char*>(&response), sizeof(response), 0,
-                    (sockaddr*)&clientAddr, sizeof(clientAddr));
-                return true;
-            }
+        ClientID existingID = FindClientByAddress(clientAddr);
+        if (existingID != 0) {
+            // Client already connected, resend the accept message
+            ConnectAcceptMessage response;
+            response.clientID = 0; // Server ID
+            response.sequence = 0;
+            response.assignedID = existingID;
+            response.totalPlayers = static_cast<uint8_t>(clients.size());
+
+            QueueLocked(clients[existingID], &response, sizeof(response));
+            return true;
         }
 
-        // Check if we can accept more clients (limit to 4 players)
-        if (clients.size() >= 4) {
+        // Check if we can accept more clients
+        newID = AllocateClientID();
+        if (newID == 0) {
             // Send reject message
             NetworkMessage response;
             response.type = MessageType::CONNECT_REJECT;
             response.clientID = 0; // Server ID
             response.sequence = 0;
 
-            sendto(socket, reinterpret_cast<const char*>(&response), sizeof(response), 0,
-                (sockaddr*)&clientAddr, sizeof(clientAddr));
+            SendRaw(clientAddr, 0, &response, sizeof(response));
             return false;
         }
 
         // Accept the new client
-        ClientID newID = nextClientID++;
-
         ClientConnection newClient;
         newClient.address = clientAddr;
         newClient.id = newID;
         newClient.active = true;
-        newClient.lastHeartbeatTime = std::chrono::steady_clock::now();
+        newClient.lastHeartbeatTime = now;
+
+        // Start with full buckets so the first burst after connecting is never dropped
+        newClient.rateLimit.packetTokens = rateLimit.packetBurst;
+        newClient.rateLimit.byteTokens = rateLimit.byteBurst;
+        newClient.rateLimit.lastRefill = now;
+        newClient.rateLimit.windowStart = now;
 
         // Convert IP address to string
         char ipStr[INET_ADDRSTRLEN];
@@ -250,6 +461,7 @@ bool UDPServer::HandleConnectionRequest(const sockaddr_in& clientAddr) {
         newClient.port = ntohs(clientAddr.sin_port);
 
         clients[newID] = newClient;
+        clientsByAddress[AddressKey(clientAddr)] = newID;
 
         // Send accept message
         ConnectAcceptMessage response;
@@ -258,46 +470,46 @@ bool UDPServer::HandleConnectionRequest(const sockaddr_in& clientAddr) {
         response.assignedID = newID;
         response.totalPlayers = static_cast<uint8_t>(clients.size());
 
-        sendto(socket, reinterpret_cast<const char*>(&response), sizeof(response), 0,
-            (sockaddr*)&clientAddr, sizeof(clientAddr));
+        // Goes out with the first flush, together with the first snapshot
+        QueueLocked(clients[newID], &response, sizeof(response));
 
         std::cout << "New client connected: ID=" << (int)newID
             << ", IP=" << newClient.ip
             << ", Port=" << newClient.port << std::endl;
-
-        // Call the connect callback
-        onClientConnect(newID);
-        return true;
     }
+
+    // Call the connect callback
+    onClientConnect(newID);
+    return true;
 }
 
-void UDPServer::CheckClientTimeouts() {
-    auto now = std::chrono::steady_clock::now();
+void UDPServer::CheckClientTimeouts(TimePoint now) {
     constexpr auto TIMEOUT_DURATION = std::chrono::seconds(5);
 
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    for (auto it = clients.begin(); it != clients.end();) {
-        if (it->second.active &&
-            now - it->second.lastHeartbeatTime > TIMEOUT_DURATION) {
-            // Client timed out
-            std::cout << "Client " << (int)it->first << " timed out" << std::endl;
-            it->second.active = false;
-            onClientDisconnect(it->first);
-            ++it;
-        }
-        else {
-            ++it;
+    std::vector<ClientID> timedOut;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (auto it = clients.begin(); it != clients.end(); ++it) {
+            if (it->second.active &&
+                now - it->second.lastHeartbeatTime > TIMEOUT_DURATION) {
+                // Client timed out
+                std::cout << "Client " << (int)it->first << " timed out" << std::endl;
+                DeactivateLocked(it->second);
+                timedOut.push_back(it->first);
+            }
         }
     }
+
+    for (ClientID id : timedOut) {
+        onClientDisconnect(id);
+    }
 }
 
 bool UDPServer::SendToClient(ClientID clientID, const void* data, size_t size) {
     std::lock_guard<std::mutex> lock(clientsMutex);
     auto it = clients.find(clientID);
     if (it != clients.end() && it->second.active) {
-        int result = sendto(socket, reinterpret_cast<const char*>(data), static_cast<int>(size), 0,
-            (sockaddr*)&it->second.address, sizeof(it->second.address));
-        return result != SOCKET_ERROR;
+        return SendRaw(it->second.address, clientID, data, size);
     }
     return false;
 }
@@ -307,9 +519,29 @@ bool UDPServer::BroadcastToAll(const void* data, size_t size) {
     std::lock_guard<std::mutex> lock(clientsMutex);
     for (auto& pair : clients) {
         if (pair.second.active) {
-            int result = sendto(socket, reinterpret_cast<const char*>(data), static_cast<int>(size), 0,
-                (sockaddr*)&pair.second.address, sizeof(pair.second.address));
-            if (result == SOCKET_ERROR) {
+            if (!SendRaw(pair.second.address, pair.first, data, size)) {
+                success = false;
+            }
+        }
+    }
+    return success;
+}
+
+bool UDPServer::QueueToClient(ClientID clientID, const void* data, size_t size) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    auto it = clients.find(clientID);
+    if (it != clients.end() && it->second.active) {
+        return QueueLocked(it->second, data, size);
+    }
+    return false;
+}
+
+bool UDPServer::QueueToAll(const void* data, size_t size) {
+    bool success = true;
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto& pair : clients) {
+        if (pair.second.active) {
+            if (!QueueLocked(pair.second, data, size)) {
                 success = false;
             }
         }
@@ -317,6 +549,83 @@ bool UDPServer::BroadcastToAll(const void* data, size_t size) {
     return success;
 }
 
+void UDPServer::FlushOutgoing() {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (auto& pair : clients) {
+        if (pair.second.active) {
+            FlushLocked(pair.second);
+        }
+        else {
+            // Nothing is sent to disconnected clients
+            pair.second.outgoing.Clear();
+        }
+    }
+}
+
+bool UDPServer::QueueLocked(ClientConnection& client, const void* data, size_t size) {
+    queuedMessages.fetch_add(1, std::memory_order_relaxed);
+
+    if (!PacketBuilder::CanBundle(size)) {
+        // Flush first so the client sees the messages in queue order
+        bool flushed = FlushLocked(client);
+        flushedDatagrams.fetch_add(1, std::memory_order_relaxed);
+        return SendRaw(client.address, client.id, data, size) && flushed;
+    }
+
+    if (client.outgoing.Append(data, size)) {
+        return true;
+    }
+
+    bool flushed = FlushLocked(client);
+    client.outgoing.Append(data, size);
+    return flushed;
+}
+
+bool UDPServer::FlushLocked(ClientConnection& client) {
+    if (client.outgoing.Empty()) {
+        return true;
+    }
+
+    size_t size;
+    const char* data = client.outgoing.Finish(client.outgoingSequence++, size);
+    bool result = SendRaw(client.address, client.id, data, size);
+    client.outgoing.Clear();
+
+    flushedDatagrams.fetch_add(1, std::memory_order_relaxed);
+    return result;
+}
+
+ClientID UDPServer::AllocateClientID() {
+    size_t activeCount = 0;
+    for (auto& pair : clients) {
+        if (pair.second.active) {
+            activeCount++;
+        }
+    }
+    if (activeCount >= maxClients) {
+        return 0;
+    }
+
+    // IDs of disconnected clients are reused so long load tests don't run out of IDs
+    for (int attempt = 0; attempt < 255; attempt++) {
+        ClientID candidate = nextClientID++;
+        if (nextClientID == 0) {
+            nextClientID = 1;
+        }
+
+        auto it = clients.find(candidate);
+        if (it == clients.end() || !it->second.active) {
+            return candidate;
+        }
+    }
+    return 0;
+}
+
+void UDPServer::SetMaxClients(size_t count) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    maxClients = (std::min)((std::max)(count, static_cast<size_t>(1)), static_cast<size_t>(254));
+}
+
 size_t UDPServer::GetClientCount() const {
     std::lock_guard<std::mutex> lock(clientsMutex);
     size_t count = 0;
@@ -337,11 +646,24 @@ bool UDPServer::IsClientConnected(ClientID clientID) const {
 // =================== UDPClient Implementation ===================
 
 UDPClient::UDPClient() : socket(INVALID_SOCKET), isRunning(false), isConnected(false),
-clientID(0), sequenceNumber(0) {
+clientID(0), sequenceNumber(0), outgoingSequence(0), lastSendTicks(0) {
     // Initialize callbacks to empty functions to avoid nullptr checks
     onConnect = [](ClientID) {};
     onDisconnect = []() {};
     onMessage = [](const void*, size_t) {};
+
+    dispatcher.Register<MessageType::CONNECT_ACCEPT>(
+        [this](const MessageView<ConnectAcceptMessage>& msg) { HandleConnectAccept(msg.Get()); });
+    dispatcher.Register<MessageType::CONNECT_REJECT>(
+        [this](const MessageView<NetworkMessage>&) { HandleConnectReject(); });
+    dispatcher.Register<MessageType::DISCONNECT>(
+        [this](const MessageView<NetworkMessage>&) { HandleServerDisconnect(); });
+    dispatcher.Register<MessageType::BUNDLE>(
+        [this](const MessageView<BundleMessage>& bundle) {
+            ForEachBundledMessage(bundle.Data(), bundle.Size(),
+                [this](const void* data, size_t size) { dispatcher.Dispatch(data, size); });
+        });
+    dispatcher.SetFallback([this](const void* data, size_t size) { onMessage(data, size); });
 }
 
 UDPClient::~UDPClient() {
@@ -449,14 +771,14 @@ bool UDPClient::Connect(const std::string& serverIP, uint16_t serverPort) {
 
 void UDPClient::Disconnect() {
     if (isConnected) {
-        // Send disconnect message
+        // Send disconnect message behind anything still queued
         NetworkMessage disconnectMsg;
         disconnectMsg.type = MessageType::DISCONNECT;
         disconnectMsg.clientID = clientID;
         disconnectMsg.sequence = sequenceNumber++;
 
-        sendto(socket, reinterpret_cast<const char*>(&disconnectMsg), sizeof(disconnectMsg), 0,
-            (sockaddr*)&serverAddr, sizeof(serverAddr));
+        QueueToServer(&disconnectMsg, sizeof(disconnectMsg));
+        FlushToServer();
 
         isConnected = false;
         clientID = 0;
@@ -471,32 +793,76 @@ bool UDPClient::SendToServer(const void* data, size_t size) {
         return false;
     }
 
+    return SendDatagram(data, size);
+}
+
+bool UDPClient::QueueToServer(const void* data, size_t size) {
+    if (!isConnected) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(sendMutex);
+    if (!PacketBuilder::CanBundle(size)) {
+        // Keep the queue order
+        bool flushed = FlushLocked();
+        return SendDatagram(data, size) && flushed;
+    }
+
+    if (outgoing.Append(data, size)) {
+        return true;
+    }
+
+    bool flushed = FlushLocked();
+    outgoing.Append(data, size);
+    return flushed;
+}
+
+bool UDPClient::FlushToServer() {
+    std::lock_guard<std::mutex> lock(sendMutex);
+    return FlushLocked();
+}
+
+bool UDPClient::FlushLocked() {
+    if (outgoing.Empty()) {
+        return true;
+    }
+
+    size_t size;
+    const char* data = outgoing.Finish(outgoingSequence++, size);
+    bool result = SendDatagram(data, size);
+    outgoing.Clear();
+    return result;
+}
+
+bool UDPClient::SendDatagram(const void* data, size_t size) {
     int result = sendto(socket, reinterpret_cast<const char*>(data), static_cast<int>(size), 0,
         (sockaddr*)&serverAddr, sizeof(serverAddr));
 
+    lastSendTicks = std::chrono::steady_clock::now().time_since_epoch().count();
     return result != SOCKET_ERROR;
 }
 
 void UDPClient::NetworkThread() {
     std::cout << "Client network thread started" << std::endl;
 
-    char buffer[MAX_PACKET_SIZE];
+    // Snapshots are variable length and can be larger than MAX_PACKET_SIZE
+    std::vector<char> buffer(MAX_DATAGRAM_SIZE);
     sockaddr_in senderAddr;
     int senderAddrSize = sizeof(senderAddr);
 
-    auto lastHeartbeatTime = std::chrono::steady_clock::now();
     constexpr auto HEARTBEAT_INTERVAL = std::chrono::seconds(1);
 
     while (isRunning) {
-        // Send heartbeats if connected
+        // Any datagram refreshes the server's timeout, so heartbeats only fill silent periods
         auto currentTime = std::chrono::steady_clock::now();
-        if (isConnected && currentTime - lastHeartbeatTime > HEARTBEAT_INTERVAL) {
+        auto lastSendTime = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(lastSendTicks.load()));
+        if (isConnected && currentTime - lastSendTime > HEARTBEAT_INTERVAL) {
             SendHeartbeat();
-            lastHeartbeatTime = currentTime;
         }
 
         // Try to receive a message
-        int bytesReceived = recvfrom(socket, buffer, MAX_PACKET_SIZE, 0,
+        int bytesReceived = recvfrom(socket, buffer.data(), static_cast<int>(buffer.size()), 0,
             (sockaddr*)&senderAddr, &senderAddrSize);
 
         if (bytesReceived == SOCKET_ERROR) {
@@ -513,14 +879,6 @@ void UDPClient::NetworkThread() {
             }
         }
 
-        // Must receive at least the header
-        if (bytesReceived < sizeof(NetworkMessage)) {
-            continue;
-        }
-
-        // Handle message based on type
-        NetworkMessage* header = reinterpret_cast<NetworkMessage*>(buffer);
-
         // Check if message is from our server
         if (senderAddr.sin_addr.s_addr != serverAddr.sin_addr.s_addr ||
             senderAddr.sin_port != serverAddr.sin_port) {
@@ -528,46 +886,34 @@ void UDPClient::NetworkThread() {
             continue;
         }
 
-        switch (header->type) {
-        case MessageType::CONNECT_ACCEPT:
-        {
-            if (!isConnected) {
-                ConnectAcceptMessage* msg = reinterpret_cast<ConnectAcceptMessage*>(buffer);
-                clientID = msg->assignedID;
-                isConnected = true;
-                std::cout << "Connected to server as client " << (int)clientID << std::endl;
-                onConnect(clientID);
-            }
-            break;
-        }
-
-        case MessageType::CONNECT_REJECT:
-        {
-            std::cout << "Connection rejected by server" << std::endl;
-            isConnected = false;
-            onDisconnect();
-            break;
-        }
+        dispatcher.Dispatch(buffer.data(), static_cast<size_t>(bytesReceived));
+    }
 
-        case MessageType::DISCONNECT:
-        {
-            if (isConnected) {
-                std::cout << "Disconnected by server" << std::endl;
-                isConnected = false;
-                clientID = 0;
-                onDisconnect();
-            }
-            break;
-        }
+    std::cout << "Client network thread stopped" << std::endl;
+}
 
-        default:
-            // Pass message to handler
-            onMessage(buffer, bytesReceived);
-            break;
-        }
+void UDPClient::HandleConnectAccept(const ConnectAcceptMessage& msg) {
+    if (!isConnected) {
+        clientID = msg.assignedID;
+        isConnected = true;
+        std::cout << "Connected to server as client " << (int)clientID << std::endl;
+        onConnect(clientID);
     }
+}
 
-    std::cout << "Client network thread stopped" << std::endl;
+void UDPClient::HandleConnectReject() {
+    std::cout << "Connection rejected by server" << std::endl;
+    isConnected = false;
+    onDisconnect();
+}
+
+void UDPClient::HandleServerDisconnect() {
+    if (isConnected) {
+        std::cout << "Disconnected by server" << std::endl;
+        isConnected = false;
+        clientID = 0;
+        onDisconnect();
+    }
 }
 
 void UDPClient::SendHeartbeat() {
@@ -580,6 +926,5 @@ void UDPClient::SendHeartbeat() {
     heartbeatMsg.clientID = clientID;
     heartbeatMsg.sequence = sequenceNumber++;
 
-    sendto(socket, reinterpret_cast<const char*>(&heartbeatMsg), sizeof(heartbeatMsg), 0,
-        (sockaddr*)&serverAddr, sizeof(serverAddr));
+    SendDatagram(&heartbeatMsg, sizeof(heartbeatMsg));
 }
\ No newline at end of file
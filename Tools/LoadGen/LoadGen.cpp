@@ -0,0 +1,691 @@
+// LoadGen.cpp
+// Headless load generator for GameServer.
+// Spawns N bot connections speaking the UDPClient protocol, multiplexed over a few
+// threads with epoll, sends scripted or random PlayerInputMessage streams and reports
+// connect latency, snapshot rate, snapshot size and packet loss as percentiles.
+// Snapshots that carry a world hash are checked against their contents, and the bots send
+// the hash of the latest one back with their input so the server checks it too. Under
+// event replication each bot keeps an ObjectReplica, so snapshots without the objects are
+// checked against the replica.
+//
+// Linux only. Build from this directory with:
+//   g++ -std=c++17 -O2 -pthread -I../../CSD1130_Asteroids/Include LoadGen.cpp -o loadgen
+//
+// Usage:
+//   loadgen [--server ip] [--port n] [--bots n] [--threads n] [--duration seconds]
+//           [--input-rate hz] [--ramp ms] [--seed n] [--script random|circle|idle|<file>]
+//
+// A script file holds one input frame per line, cycled for the whole run. Each line lists
+// the held keys: U (up), D (down), L (left), R (right), F (fire); "-" is an empty frame.
+//
+// The server only accepts 4 players by default; start it with
+// GameServer::Initialize(port, maxPlayers) to load test with more bots.
+
+#include "NetworkProtocol.h"
+#include "ObjectReplica.h"
+#include "PacketBuilder.h"
+#include "WorldHash.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+namespace {
+
+// Largest datagram a snapshot can grow to; the server does not clamp to MAX_PACKET_SIZE
+constexpr size_t RECV_BUFFER_SIZE = 65536;
+
+constexpr auto CONNECT_RETRY_INTERVAL = std::chrono::seconds(1);
+constexpr auto HEARTBEAT_INTERVAL = std::chrono::seconds(1);
+
+struct Options {
+    std::string serverIP = "127.0.0.1";
+    uint16_t port = 7777;
+    int bots = 100;
+    int threads = 4;
+    double duration = 30.0;
+    double inputRate = 30.0;
+    int rampMs = 5;
+    uint32_t seed = 1;
+    std::string script = "random";
+};
+
+// One input frame of a script, as key bits
+enum InputKey : uint8_t {
+    KEY_UP = 1 << 0,
+    KEY_DOWN = 1 << 1,
+    KEY_LEFT = 1 << 2,
+    KEY_RIGHT = 1 << 3,
+    KEY_FIRE = 1 << 4
+};
+
+struct Bot {
+    int fd = -1;
+    bool connected = false;
+    bool rejected = false;
+    ClientID id = 0;
+    uint16_t sequence = 0;
+
+    Clock::time_point startTime;
+    Clock::time_point lastConnectAttempt;
+    Clock::time_point nextInput;
+    Clock::time_point nextHeartbeat;
+    double connectLatencyMs = -1.0;
+    int connectAttempts = 0;
+
+    uint64_t snapshots = 0;
+    uint64_t lostSnapshots = 0;
+    bool haveSequence = false;
+    uint16_t lastSequence = 0;
+    Clock::time_point firstSnapshot;
+    Clock::time_point lastSnapshot;
+    uint32_t ackTick = 0;       // latest snapshot with a world hash, echoed in the input
+    uint32_t ackHash = 0;
+    bool haveServerTick = false;
+    uint32_t serverTick = 0;    // latest tick heard of, inputs are stamped for the next one
+
+    ObjectReplica replica;      // event replication: asteroids and bullets between snapshots
+    bool haveEventSequence = false;
+    uint16_t lastEventSequence = 0;
+
+    size_t scriptStep = 0;
+    std::mt19937 rng;
+    uint8_t keys = 0;
+};
+
+struct ThreadResult {
+    std::vector<double> connectLatencyMs;
+    std::vector<double> snapshotRateHz;
+    std::vector<double> lossPercent;
+    std::vector<double> snapshotBytes;
+    uint64_t packetsSent = 0;
+    uint64_t bytesSent = 0;
+    uint64_t packetsReceived = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t hashChecks = 0;
+    uint64_t hashMismatches = 0;
+    uint64_t inputFrames = 0;
+    uint64_t eventMessages = 0;
+    uint64_t eventBytes = 0;
+    uint64_t lostEventMessages = 0;
+    int connected = 0;
+    int rejected = 0;
+    int neverConnected = 0;
+};
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--server") options.serverIP = value;
+        else if (arg == "--port") options.port = static_cast<uint16_t>(std::atoi(value.c_str()));
+        else if (arg == "--bots") options.bots = std::atoi(value.c_str());
+        else if (arg == "--threads") options.threads = std::atoi(value.c_str());
+        else if (arg == "--duration") options.duration = std::atof(value.c_str());
+        else if (arg == "--input-rate") options.inputRate = std::atof(value.c_str());
+        else if (arg == "--ramp") options.rampMs = std::atoi(value.c_str());
+        else if (arg == "--seed") options.seed = static_cast<uint32_t>(std::strtoul(value.c_str(), nullptr, 10));
+        else if (arg == "--script") options.script = value;
+        else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if (options.bots <= 0 || options.threads <= 0 || options.inputRate <= 0.0 || options.duration <= 0.0) {
+        std::cerr << "bots, threads, input-rate and duration must be positive" << std::endl;
+        return false;
+    }
+    options.threads = std::min(options.threads, options.bots);
+    return true;
+}
+
+// Builds the scripted input frames; an empty result means random input
+bool LoadScript(const std::string& script, std::vector<uint8_t>& frames) {
+    frames.clear();
+    if (script == "random") {
+        return true;
+    }
+    if (script == "idle") {
+        frames.push_back(0);
+        return true;
+    }
+    if (script == "circle") {
+        // Thrust while turning, firing every fourth frame
+        frames = { KEY_UP | KEY_LEFT | KEY_FIRE, KEY_UP | KEY_LEFT, KEY_UP | KEY_LEFT, KEY_UP | KEY_LEFT };
+        return true;
+    }
+
+    std::ifstream file(script);
+    if (!file) {
+        std::cerr << "Cannot open script " << script << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        uint8_t keys = 0;
+        for (char c : line) {
+            switch (c) {
+            case 'U': case 'u': keys |= KEY_UP; break;
+            case 'D': case 'd': keys |= KEY_DOWN; break;
+            case 'L': case 'l': keys |= KEY_LEFT; break;
+            case 'R': case 'r': keys |= KEY_RIGHT; break;
+            case 'F': case 'f': keys |= KEY_FIRE; break;
+            default: break;
+            }
+        }
+        frames.push_back(keys);
+    }
+
+    if (frames.empty()) {
+        std::cerr << "Script " << script << " has no frames" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double Percentile(std::vector<double> values, double percent) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = static_cast<size_t>(percent / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(rank, values.size() - 1)];
+}
+
+void PrintPercentiles(const char* name, const std::vector<double>& values, const char* unit) {
+    std::printf("%-22s n=%-7zu p50=%-10.2f p90=%-10.2f p99=%-10.2f max=%-10.2f %s\n",
+        name, values.size(),
+        Percentile(values, 50.0), Percentile(values, 90.0),
+        Percentile(values, 99.0), Percentile(values, 100.0), unit);
+}
+
+class BotThread {
+public:
+    BotThread(const Options& options, const sockaddr_in& serverAddr,
+        const std::vector<uint8_t>& script, int firstBot, int botCount)
+        : options(options), serverAddr(serverAddr), script(script),
+        firstBot(firstBot), epollFD(-1) {
+        bots.resize(botCount);
+    }
+
+    ~BotThread() {
+        for (Bot& bot : bots) {
+            if (bot.fd >= 0) {
+                close(bot.fd);
+            }
+        }
+        if (epollFD >= 0) {
+            close(epollFD);
+        }
+    }
+
+    void Run(Clock::time_point runStart, Clock::time_point runEnd) {
+        epollFD = epoll_create1(0);
+        if (epollFD < 0) {
+            std::perror("epoll_create1");
+            return;
+        }
+
+        const auto inputInterval = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / options.inputRate));
+
+        // Stagger the connects so the server sees a ramp, not a single burst
+        for (size_t i = 0; i < bots.size(); i++) {
+            Bot& bot = bots[i];
+            int globalIndex = firstBot + static_cast<int>(i);
+            bot.startTime = runStart + std::chrono::milliseconds(options.rampMs * globalIndex);
+            bot.rng.seed(options.seed + static_cast<uint32_t>(globalIndex));
+            bot.scriptStep = script.empty() ? 0 : globalIndex % script.size();
+
+            bot.fd = socket(AF_INET, SOCK_DGRAM, 0);
+            if (bot.fd < 0) {
+                std::perror("socket");
+                continue;
+            }
+            fcntl(bot.fd, F_SETFL, fcntl(bot.fd, F_GETFL, 0) | O_NONBLOCK);
+
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.u32 = static_cast<uint32_t>(i);
+            epoll_ctl(epollFD, EPOLL_CTL_ADD, bot.fd, &event);
+        }
+
+        std::vector<char> buffer(RECV_BUFFER_SIZE);
+        epoll_event events[64];
+
+        while (Clock::now() < runEnd) {
+            auto now = Clock::now();
+
+            for (Bot& bot : bots) {
+                if (bot.fd < 0 || bot.rejected || now < bot.startTime) {
+                    continue;
+                }
+
+                if (!bot.connected) {
+                    if (bot.connectAttempts == 0 || now - bot.lastConnectAttempt >= CONNECT_RETRY_INTERVAL) {
+                        NetworkMessage connectMsg(MessageType::CONNECT_REQUEST, 0, bot.sequence++);
+                        Send(bot, &connectMsg, sizeof(connectMsg));
+                        bot.lastConnectAttempt = now;
+                        bot.connectAttempts++;
+                    }
+                    continue;
+                }
+
+                if (now >= bot.nextInput) {
+                    SendInput(bot);
+                    bot.nextInput += inputInterval;
+                    if (bot.nextInput < now) {
+                        bot.nextInput = now + inputInterval;
+                    }
+                }
+
+                if (now >= bot.nextHeartbeat) {
+                    NetworkMessage heartbeat(MessageType::HEARTBEAT, bot.id, bot.sequence++);
+                    Send(bot, &heartbeat, sizeof(heartbeat));
+                    bot.nextHeartbeat = now + HEARTBEAT_INTERVAL;
+                }
+            }
+
+            int ready = epoll_wait(epollFD, events, 64, 1);
+            for (int e = 0; e < ready; e++) {
+                Receive(bots[events[e].data.u32], buffer, inputInterval);
+            }
+        }
+
+        // Leave cleanly so the server does not wait for timeouts
+        for (Bot& bot : bots) {
+            if (bot.connected) {
+                NetworkMessage disconnect(MessageType::DISCONNECT, bot.id, bot.sequence++);
+                Send(bot, &disconnect, sizeof(disconnect));
+            }
+        }
+
+        Collect();
+    }
+
+    const ThreadResult& GetResult() const { return result; }
+
+private:
+    void Send(Bot& bot, const void* data, size_t size) {
+        ssize_t sent = sendto(bot.fd, data, size, 0,
+            reinterpret_cast<const sockaddr*>(&serverAddr), sizeof(serverAddr));
+        if (sent >= 0) {
+            result.packetsSent++;
+            result.bytesSent += static_cast<uint64_t>(sent);
+        }
+    }
+
+    void SendInput(Bot& bot) {
+        if (script.empty()) {
+            // Random walk: usually keep the held keys, sometimes change them
+            if (bot.rng() % 8 == 0) {
+                bot.keys = static_cast<uint8_t>(bot.rng() & 0x1F);
+            }
+        }
+        else {
+            bot.keys = script[bot.scriptStep];
+            bot.scriptStep = (bot.scriptStep + 1) % script.size();
+        }
+
+        PlayerInputMessage input;
+        input.clientID = bot.id;
+        input.sequence = bot.sequence++;
+        input.up = (bot.keys & KEY_UP) != 0;
+        input.down = (bot.keys & KEY_DOWN) != 0;
+        input.left = (bot.keys & KEY_LEFT) != 0;
+        input.right = (bot.keys & KEY_RIGHT) != 0;
+        input.fire = (bot.keys & KEY_FIRE) != 0;
+        input.ackTick = bot.ackTick;
+        input.ackHash = bot.ackHash;
+        input.inputTick = bot.haveServerTick ? bot.serverTick + 1 : NO_INPUT_TICK;
+        Send(bot, &input, sizeof(input));
+    }
+
+    void Receive(Bot& bot, std::vector<char>& buffer, Clock::duration inputInterval) {
+        for (;;) {
+            sockaddr_in sender = {};
+            socklen_t senderSize = sizeof(sender);
+            ssize_t received = recvfrom(bot.fd, buffer.data(), buffer.size(), 0,
+                reinterpret_cast<sockaddr*>(&sender), &senderSize);
+            if (received < 0) {
+                return; // EAGAIN or a transient error, try again on the next wakeup
+            }
+
+            if (sender.sin_addr.s_addr != serverAddr.sin_addr.s_addr ||
+                sender.sin_port != serverAddr.sin_port ||
+                received < static_cast<ssize_t>(sizeof(NetworkMessage))) {
+                continue;
+            }
+
+            result.packetsReceived++;
+            result.bytesReceived += static_cast<uint64_t>(received);
+
+            auto now = Clock::now();
+            NetworkMessage header;
+            std::memcpy(&header, buffer.data(), sizeof(header));
+
+            if (header.type == MessageType::BUNDLE) {
+                ForEachBundledMessage(buffer.data(), static_cast<size_t>(received),
+                    [&](const void* data, size_t size) { HandleMessage(bot, data, size, now, inputInterval); });
+            }
+            else {
+                HandleMessage(bot, buffer.data(), static_cast<size_t>(received), now, inputInterval);
+            }
+        }
+    }
+
+    void HandleMessage(Bot& bot, const void* data, size_t size, Clock::time_point now,
+        Clock::duration inputInterval) {
+        NetworkMessage header;
+        std::memcpy(&header, data, sizeof(header));
+
+        switch (header.type) {
+        case MessageType::CONNECT_ACCEPT:
+            if (!bot.connected && size >= sizeof(ConnectAcceptMessage)) {
+                ConnectAcceptMessage accept;
+                std::memcpy(&accept, data, sizeof(accept));
+                bot.id = accept.assignedID;
+                bot.connected = true;
+                bot.connectLatencyMs = std::chrono::duration<double, std::milli>(
+                    now - bot.lastConnectAttempt).count();
+                bot.nextInput = now + inputInterval;
+                bot.nextHeartbeat = now + HEARTBEAT_INTERVAL;
+            }
+            break;
+
+        case MessageType::CONNECT_REJECT:
+            if (!bot.connected) {
+                bot.rejected = true;
+            }
+            break;
+
+        case MessageType::DISCONNECT:
+            bot.connected = false;
+            break;
+
+        case MessageType::GAME_STATE:
+        {
+            if (bot.haveSequence) {
+                uint16_t gap = static_cast<uint16_t>(header.sequence - bot.lastSequence);
+                // Anything that is not "ahead" is a reordered or duplicated snapshot
+                if (gap > 0 && gap < 0x8000) {
+                    bot.lostSnapshots += gap - 1;
+                    bot.lastSequence = header.sequence;
+                }
+            }
+            else {
+                bot.haveSequence = true;
+                bot.lastSequence = header.sequence;
+                bot.firstSnapshot = now;
+            }
+            bot.lastSnapshot = now;
+            bot.snapshots++;
+            result.snapshotBytes.push_back(static_cast<double>(size));
+            if (size >= sizeof(GameStateMessage)) {
+                GameStateMessage msg;
+                std::memcpy(&msg, data, sizeof(msg));
+                bot.serverTick = std::max(bot.serverTick, msg.serverTick);
+                bot.haveServerTick = true;
+            }
+            bot.replica.ApplySnapshot(data, size);
+            CheckWorldHash(bot, data, size);
+            break;
+        }
+
+        // Event replication: after a lost message the replica waits for the next full snapshot
+        case MessageType::OBJECT_EVENTS:
+            result.eventMessages++;
+            result.eventBytes += size;
+            if (bot.haveEventSequence) {
+                uint16_t gap = static_cast<uint16_t>(header.sequence - bot.lastEventSequence);
+                if (gap == 0 || gap >= 0x8000) {
+                    break; // duplicated or reordered
+                }
+                if (gap > 1) {
+                    result.lostEventMessages += gap - 1;
+                    bot.replica.Invalidate();
+                }
+            }
+            bot.haveEventSequence = true;
+            bot.lastEventSequence = header.sequence;
+            if (!bot.replica.ApplyEvents(data, size)) {
+                bot.replica.Invalidate();
+            }
+            break;
+
+        // Rollback mode: the per tick input relay, used here only as the server's tick clock
+        case MessageType::INPUT_FRAME:
+            if (size >= sizeof(InputFrameMessage)) {
+                InputFrameMessage msg;
+                std::memcpy(&msg, data, sizeof(msg));
+                bot.serverTick = std::max(bot.serverTick, msg.serverTick);
+                bot.haveServerTick = true;
+                result.inputFrames++;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // Rebuilds the world hash from the snapshot contents, the view a real client would have
+    void CheckWorldHash(Bot& bot, const void* data, size_t size) {
+        GameStateMessage msg;
+        if (size < sizeof(msg)) {
+            return;
+        }
+        std::memcpy(&msg, data, sizeof(msg));
+        if (msg.worldHash == 0) {
+            return;
+        }
+
+        size_t expected = sizeof(msg) + msg.playerCount * sizeof(ShipState) +
+            msg.asteroidCount * sizeof(AsteroidState) + msg.bulletCount * sizeof(BulletState);
+        if (size < expected) {
+            return;
+        }
+
+        // Without the objects the check needs a replica that is up to date
+        const bool objectsOmitted = (msg.flags & GAME_STATE_OBJECTS_OMITTED) != 0;
+        if (objectsOmitted && (!bot.replica.IsValid() || bot.replica.GetTick() > msg.serverTick)) {
+            return;
+        }
+
+        WorldHash hash;
+        const char* cursor = static_cast<const char*>(data) + sizeof(msg);
+        for (int i = 0; i < msg.playerCount; i++, cursor += sizeof(ShipState)) {
+            ShipState ship;
+            std::memcpy(&ship, cursor, sizeof(ship));
+            if (ship.active) {
+                hash.Add(WORLD_HASH_SHIP, ship.posX, ship.posY, ship.velocityX, ship.velocityY);
+            }
+        }
+        for (int i = 0; i < msg.asteroidCount; i++, cursor += sizeof(AsteroidState)) {
+            AsteroidState asteroid;
+            std::memcpy(&asteroid, cursor, sizeof(asteroid));
+            if (asteroid.active) {
+                hash.Add(WORLD_HASH_ASTEROID, asteroid.posX, asteroid.posY, asteroid.velocityX, asteroid.velocityY);
+            }
+        }
+        for (int i = 0; i < msg.bulletCount; i++, cursor += sizeof(BulletState)) {
+            BulletState bullet;
+            std::memcpy(&bullet, cursor, sizeof(bullet));
+            if (bullet.active) {
+                hash.Add(WORLD_HASH_BULLET, bullet.posX, bullet.posY, bullet.velocityX, bullet.velocityY);
+            }
+        }
+        if (objectsOmitted) {
+            bot.replica.AdvanceTo(msg.serverTick);
+            bot.replica.AddToHash(hash);
+        }
+
+        result.hashChecks++;
+        if (hash.Value() != msg.worldHash) {
+            result.hashMismatches++;
+            std::printf("Bot %d: world hash mismatch at tick %u\n", bot.id, msg.serverTick);
+        }
+
+        bot.ackTick = msg.serverTick;
+        bot.ackHash = hash.Value();
+    }
+
+    void Collect() {
+        for (Bot& bot : bots) {
+            if (bot.connectLatencyMs >= 0.0) {
+                result.connectLatencyMs.push_back(bot.connectLatencyMs);
+                result.connected++;
+            }
+            else if (bot.rejected) {
+                result.rejected++;
+            }
+            else {
+                result.neverConnected++;
+            }
+
+            if (bot.snapshots > 1) {
+                double seconds = std::chrono::duration<double>(bot.lastSnapshot - bot.firstSnapshot).count();
+                if (seconds > 0.0) {
+                    result.snapshotRateHz.push_back((bot.snapshots - 1) / seconds);
+                }
+                result.lossPercent.push_back(
+                    100.0 * bot.lostSnapshots / static_cast<double>(bot.snapshots + bot.lostSnapshots));
+            }
+        }
+    }
+
+    const Options& options;
+    sockaddr_in serverAddr;
+    const std::vector<uint8_t>& script;
+    int firstBot;
+    int epollFD;
+    std::vector<Bot> bots;
+    ThreadResult result;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::cerr << "usage: loadgen [--server ip] [--port n] [--bots n] [--threads n] [--duration s]\n"
+            "               [--input-rate hz] [--ramp ms] [--seed n] [--script random|circle|idle|file]"
+            << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> script;
+    if (!LoadScript(options.script, script)) {
+        return 1;
+    }
+
+    sockaddr_in serverAddr = {};
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(options.port);
+    if (inet_pton(AF_INET, options.serverIP.c_str(), &serverAddr.sin_addr) != 1) {
+        std::cerr << "Invalid server address " << options.serverIP << std::endl;
+        return 1;
+    }
+
+    std::printf("Load test: %d bots on %d threads against %s:%u for %.1f s, input %.1f Hz, script %s\n",
+        options.bots, options.threads, options.serverIP.c_str(), options.port,
+        options.duration, options.inputRate, options.script.c_str());
+
+    std::vector<std::unique_ptr<BotThread>> workers;
+    int assigned = 0;
+    for (int t = 0; t < options.threads; t++) {
+        int count = options.bots / options.threads + (t < options.bots % options.threads ? 1 : 0);
+        workers.emplace_back(new BotThread(options, serverAddr, script, assigned, count));
+        assigned += count;
+    }
+
+    auto runStart = Clock::now();
+    auto runEnd = runStart + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(options.duration));
+
+    std::vector<std::thread> threads;
+    for (auto& worker : workers) {
+        BotThread* w = worker.get();
+        threads.emplace_back([w, runStart, runEnd]() { w->Run(runStart, runEnd); });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    ThreadResult total;
+    for (auto& worker : workers) {
+        const ThreadResult& r = worker->GetResult();
+        total.connectLatencyMs.insert(total.connectLatencyMs.end(), r.connectLatencyMs.begin(), r.connectLatencyMs.end());
+        total.snapshotRateHz.insert(total.snapshotRateHz.end(), r.snapshotRateHz.begin(), r.snapshotRateHz.end());
+        total.lossPercent.insert(total.lossPercent.end(), r.lossPercent.begin(), r.lossPercent.end());
+        total.snapshotBytes.insert(total.snapshotBytes.end(), r.snapshotBytes.begin(), r.snapshotBytes.end());
+        total.packetsSent += r.packetsSent;
+        total.bytesSent += r.bytesSent;
+        total.packetsReceived += r.packetsReceived;
+        total.bytesReceived += r.bytesReceived;
+        total.hashChecks += r.hashChecks;
+        total.inputFrames += r.inputFrames;
+        total.eventMessages += r.eventMessages;
+        total.eventBytes += r.eventBytes;
+        total.lostEventMessages += r.lostEventMessages;
+        total.hashMismatches += r.hashMismatches;
+        total.connected += r.connected;
+        total.rejected += r.rejected;
+        total.neverConnected += r.neverConnected;
+    }
+
+    double seconds = std::chrono::duration<double>(Clock::now() - runStart).count();
+    std::printf("\nBots: %d connected, %d rejected, %d never answered\n",
+        total.connected, total.rejected, total.neverConnected);
+    std::printf("Sent: %llu packets (%.1f/s), %llu bytes; received: %llu packets (%.1f/s), %llu bytes\n\n",
+        static_cast<unsigned long long>(total.packetsSent), total.packetsSent / seconds,
+        static_cast<unsigned long long>(total.bytesSent),
+        static_cast<unsigned long long>(total.packetsReceived), total.packetsReceived / seconds,
+        static_cast<unsigned long long>(total.bytesReceived));
+
+    PrintPercentiles("connect latency", total.connectLatencyMs, "ms");
+    PrintPercentiles("snapshot rate/bot", total.snapshotRateHz, "Hz");
+    PrintPercentiles("snapshot size", total.snapshotBytes, "bytes");
+    PrintPercentiles("snapshot loss/bot", total.lossPercent, "%");
+    if (total.hashChecks > 0) {
+        std::printf("world hash: %llu snapshots checked, %llu mismatches\n",
+            static_cast<unsigned long long>(total.hashChecks),
+            static_cast<unsigned long long>(total.hashMismatches));
+    }
+    if (total.inputFrames > 0) {
+        std::printf("input frames: %llu (%.1f/s per bot)\n", static_cast<unsigned long long>(total.inputFrames),
+            total.connected > 0 ? total.inputFrames / seconds / total.connected : 0.0);
+    }
+    if (total.eventMessages > 0) {
+        std::printf("object events: %llu messages, %llu bytes (%.1f bytes/s per bot), %llu lost\n",
+            static_cast<unsigned long long>(total.eventMessages), static_cast<unsigned long long>(total.eventBytes),
+            total.connected > 0 ? total.eventBytes / seconds / total.connected : 0.0,
+            static_cast<unsigned long long>(total.lostEventMessages));
+    }
+    return 0;
+}